@@ -1,28 +1,78 @@
 #include <argon2.h>
 #include <string.h>
+#include <sys/mman.h>
 #include "framework.hpp"
+#include "argon2_core.hpp"
 
 class Argon2: public HashBenchmark {
     private:
         unsigned int timecost;
         unsigned int memcost;
+        unsigned int lanes = 4;
+        bool arena = false;
+        PagePolicy policy = PAGE_DEFAULT;
+        argon2_core::Isa isa = argon2_core::defaultIsa();
         static const int hashLen = 32;
         static const int saltLen = 16;
-        // Hashes the password and stores the result in the hash array
-        void _hashInternal(const std::string &password, uint8_t *hash, uint8_t *salt) {
+        static const int recordLen = 2 * saltLen + 1 + 2 * hashLen;
+
+        // The callbacks take no context pointer, so the calling thread's policy and block matrix
+        // are thread_local; the matrix is allocated on the thread that called argon2_core::ctx
+        inline static thread_local PagePolicy callPolicy = PAGE_DEFAULT;
+        inline static thread_local PageArena workerArena;
+
+        static int pagesAllocate(uint8_t **memory, size_t bytes) {
+            void *mem = mapPages(bytes, callPolicy);
+            if (mem == MAP_FAILED) {
+                return ARGON2_MEMORY_ALLOCATION_ERROR;
+            }
+            *memory = (uint8_t *) mem;
+            return ARGON2_OK;
+        }
+
+        static void pagesFree(uint8_t *memory, size_t bytes) {
+            unmapPages(memory, bytes, callPolicy);
+        }
+
+        static int arenaAllocate(uint8_t **memory, size_t bytes) {
+            *memory = workerArena.reserve(bytes, callPolicy);
+            return *memory == NULL ? ARGON2_MEMORY_ALLOCATION_ERROR : ARGON2_OK;
+        }
+
+        // The memory stays mapped for the next hash; argon2_core::ctx has already wiped it
+        static void arenaFree(uint8_t *memory, size_t bytes) {}
+
+        // Hashes the password with explicit parameters; returns libargon2's status codes so
+        // foreign parameters from a PHC string can fail without aborting
+        int _hashInternal(std::string_view password, uint8_t *hash, size_t hashSize, const uint8_t *salt, size_t saltSize,
+                uint32_t t, uint32_t m, uint32_t p) {
+            callPolicy = policy;
+            bool custom = policy != PAGE_DEFAULT;
             argon2_context ctx = {
-                hash, hashLen,   // Output
-                (uint8_t *) password.c_str(), (uint32_t) password.length(),  // Password
-                salt, saltLen,   // Salt
+                hash, (uint32_t) hashSize,   // Output
+                (uint8_t *) password.data(), (uint32_t) password.length(),  // Password
+                (uint8_t *) salt, (uint32_t) saltSize,   // Salt
                 NULL, 0,    // Secret data
                 NULL, 0,    // Associated Data
-                timecost, memcost, 4, 4, // Parameters (t=3, m=65536, p=4, version=19)
-                0x13,
-                NULL,
-                NULL,
+                t, m, p, p, // Parameters
+                ARGON2_VERSION_13,
+                arena ? arenaAllocate : custom ? pagesAllocate : NULL,
+                arena ? arenaFree : custom ? pagesFree : NULL,
                 0,
             };
-            assert(argon2_ctx(&ctx, Argon2_id) == ARGON2_OK);
+            return argon2_core::ctx(&ctx, Argon2_id, isa);
+        }
+
+        // Hashes the password and stores the result in the hash array
+        void _hashInternal(std::string_view password, uint8_t *hash, const uint8_t *salt) {
+            assert(_hashInternal(password, hash, hashLen, salt, saltLen, timecost, memcost, lanes) == ARGON2_OK);
+        }
+
+        // hex(salt)$hex(hash), recordLen chars
+        void encode(const uint8_t *salt, const uint8_t *hash, char *out) {
+            hexify(salt, saltLen, out);
+            out[2 * saltLen] = '$';
+            hexify(hash, hashLen, out + 2 * saltLen + 1);
         }
     public:
         Argon2(std::string name) : HashBenchmark(name) {
@@ -32,33 +82,96 @@ class Argon2: public HashBenchmark {
 
         Argon2(std::string name, unsigned int timecost, unsigned int memcost) : HashBenchmark(name), timecost(timecost), memcost(memcost) {}
 
+        // With arena set, each hashing thread reuses one pre-faulted matrix instead of a fresh allocation
+        Argon2(std::string name, unsigned int timecost, unsigned int memcost, bool arena) : HashBenchmark(name), timecost(timecost), memcost(memcost), arena(arena) {}
+
+        // Lanes also sets the threads each hash runs on
+        Argon2(std::string name, unsigned int timecost, unsigned int memcost, unsigned int lanes, bool arena) : HashBenchmark(name), timecost(timecost), memcost(memcost), lanes(lanes), arena(arena) {}
+
+        size_t memoryCost() {
+            return (size_t) memcost * 1024;
+        }
+
+        bool setPagePolicy(PagePolicy policy) {
+            this->policy = policy;
+            return true;
+        }
+
+        // BlaMka kernel for later hashes; false, and no change, if this CPU cannot run it
+        bool setIsa(argon2_core::Isa isa) {
+            if (!argon2_core::isaSupported(isa)) {
+                return false;
+            }
+            this->isa = isa;
+            return true;
+        }
+
+        argon2_core::Isa kernel() const {
+            return isa;
+        }
+
         std::string _hash(const std::string &password) {
             uint8_t hash[hashLen];
             uint8_t salt[saltLen];
             generateSeed(saltLen, (char *) salt);
             _hashInternal(password, hash, salt);
-            std::string resStr;
-            resStr.reserve(2 * hashLen + 2 * saltLen + 1);
-            hexify(salt, saltLen, resStr);
-            resStr.push_back('$');
-            hexify(hash, hashLen, resStr);
-            return resStr;
+            char res[recordLen];
+            encode(salt, hash, res);
+            return std::string(res, recordLen);
         }
 
         bool _checkHash(const std::string &hash, const std::string &password) {
-            if (hash.length() != 2 * hashLen + 2 * saltLen + 1 || hash[2 * saltLen] != '$') {
+            if (hash.length() != recordLen || hash[2 * saltLen] != '$') {
                 return false;
             }
-            uint8_t hsh[hashLen];
             uint8_t salt[saltLen];
-            for (int i = 0; i < saltLen; i++) {
-                char byte[3] = {hash[2 * i], hash[2 * i + 1], 0};
-                salt[i] = (uint8_t) strtol(byte, NULL, 16);
+            uint8_t expected[hashLen];
+            uint8_t hsh[hashLen];
+            if (!unhexify(hash.data(), saltLen, salt) || !unhexify(hash.data() + 2 * saltLen + 1, hashLen, expected)) {
+                return false;
             }
             _hashInternal(password, hsh, salt);
-            std::string resStr;
-            resStr.reserve(2 * hashLen);
-            hexify(hsh, hashLen, resStr);
-            return memcmp(resStr.data(), hash.data() + 2 * saltLen + 1, 2 * hashLen) == 0;
+            return phc::digestEqual(hsh, expected, hashLen);
+        }
+
+        // $argon2id$v=19$m=<memcost>,t=<timecost>,p=4$salt$hash, the encoding libargon2 itself uses
+        size_t phcHash(std::string_view password, char *out) {
+            PhcRecord rec;
+            strcpy(rec.id, "argon2id");
+            rec.hasVersion = true;
+            rec.version = ARGON2_VERSION_13;
+            rec.addParam("m", memcost);
+            rec.addParam("t", timecost);
+            rec.addParam("p", lanes);
+            rec.saltLen = saltLen;
+            rec.hashLen = hashLen;
+            generateSeed(saltLen, (char *) rec.salt);
+            _hashInternal(password, rec.hash, rec.salt);
+            return phc::encode(rec, out, PHC_MAX_LENGTH);
+        }
+
+        bool phcDerive(const PhcRecord &rec, std::string_view password, uint8_t *out) {
+            uint64_t m, t, p;
+            PhcCostPolicy cap = costPolicy.covering(memoryCost(), lanes, timecost, 0);
+            if (strcmp(rec.id, "argon2id") != 0 || (rec.hasVersion && rec.version != ARGON2_VERSION_13)
+                    || !rec.param("m", m) || !rec.param("t", t) || !rec.param("p", p)
+                    || m > cap.maxMemory / 1024 || t > cap.maxPasses || p > cap.maxLanes) {
+                return false;
+            }
+            return _hashInternal(password, out, rec.hashLen, rec.salt, rec.saltLen, t, m, p) == ARGON2_OK;
+        }
+
+        size_t recordSize() {
+            return recordLen;
+        }
+
+        void hashBatch(const std::string_view *passwords, size_t count, char *out) {
+            uint8_t hash[hashLen];
+            uint8_t salt[saltLen];
+            for (size_t i = 0; i < count; i++) {
+                generateSeed(saltLen, (char *) salt);
+                _hashInternal(passwords[i], hash, salt);
+                encode(salt, hash, out + i * recordLen);
+            }
         }
 };
\ No newline at end of file
@@ -0,0 +1,819 @@
+#ifndef ARGON2_CORE_HPP
+#define ARGON2_CORE_HPP
+
+#include <argon2.h>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <immintrin.h>
+#include <openssl/crypto.h>
+
+// In-tree Argon2 (RFC 9106) driven through libargon2's own argon2_context, so results match
+// argon2_ctx bit for bit; only the BlaMka compression differs per instruction set
+// Every kernel (portable reference, SSSE3, AVX2, AVX-512F) is compiled into the binary behind a
+// target attribute and one is picked at runtime from CPUID, so a single build runs on any x86-64
+// host; HASHBENCH_ARGON2_ISA=ref|ssse3|avx2|avx512 forces one
+namespace argon2_core {
+
+enum Isa { REF, SSSE3, AVX2, AVX512 };
+static const Isa allIsas[] = {REF, SSSE3, AVX2, AVX512};
+
+static const uint32_t syncPoints = 4;
+static const uint32_t blockWords = 128;
+static const uint32_t addressesInBlock = 128;
+static const size_t prehashSeedLength = 72;  // H0 plus the block and lane numbers
+
+struct alignas(64) Block {
+    uint64_t v[blockWords];
+};
+
+inline const char *isaName(Isa isa) {
+    switch (isa) {
+        case REF: return "ref";
+        case SSSE3: return "ssse3";
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+inline bool parseIsa(std::string_view name, Isa &isa) {
+    for (Isa candidate : allIsas) {
+        if (name == isaName(candidate)) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool isaSupported(Isa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case REF: return true;
+        case SSSE3: return __builtin_cpu_supports("ssse3");
+        case AVX2: return __builtin_cpu_supports("avx2");
+        case AVX512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+}
+
+inline Isa bestIsa() {
+    for (Isa isa : {AVX512, AVX2, SSSE3}) {
+        if (isaSupported(isa)) {
+            return isa;
+        }
+    }
+    return REF;
+}
+
+// Kernel a new Argon2 uses: HASHBENCH_ARGON2_ISA if this CPU runs it, else the widest one it has
+// Read once per process; a bad override is reported and ignored rather than left to fault later
+inline Isa defaultIsa() {
+    static const Isa chosen = []() {
+        const char *name = getenv("HASHBENCH_ARGON2_ISA");
+        Isa isa;
+        if (name == NULL || *name == '\0') {
+            return bestIsa();
+        }
+        if (!parseIsa(name, isa)) {
+            std::cerr << "HASHBENCH_ARGON2_ISA=" << name << " is not one of ref, ssse3, avx2, avx512; detecting" << std::endl;
+            return bestIsa();
+        }
+        if (!isaSupported(isa)) {
+            std::cerr << "HASHBENCH_ARGON2_ISA=" << name << " is not supported by this CPU; detecting" << std::endl;
+            return bestIsa();
+        }
+        return isa;
+    }();
+    return chosen;
+}
+
+static inline uint64_t rotr64(uint64_t x, int n) {
+    return (x >> n) | (x << (64 - n));
+}
+
+static inline void store32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));  // x86 is little-endian, as Argon2 and BLAKE2b are
+}
+
+// BLAKE2b with any digest length up to 64 bytes, unkeyed, as Argon2 uses it
+class Blake2b {
+    private:
+        static constexpr uint64_t IV[8] = {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+        };
+        static constexpr uint8_t SIGMA[12][16] = {
+            {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+            {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+            {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+            {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+            {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+            {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+            {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+            {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+            {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+            {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+            {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+            {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+        };
+
+        uint64_t h[8];
+        uint64_t t = 0;
+        uint8_t buf[128];
+        size_t bufLen = 0;
+        size_t outLen;
+
+        static inline void g(uint64_t *v, int a, int b, int c, int d, uint64_t x, uint64_t y) {
+            v[a] = v[a] + v[b] + x;
+            v[d] = rotr64(v[d] ^ v[a], 32);
+            v[c] = v[c] + v[d];
+            v[b] = rotr64(v[b] ^ v[c], 24);
+            v[a] = v[a] + v[b] + y;
+            v[d] = rotr64(v[d] ^ v[a], 16);
+            v[c] = v[c] + v[d];
+            v[b] = rotr64(v[b] ^ v[c], 63);
+        }
+
+        void compress(const uint8_t *block, bool last) {
+            uint64_t m[16], v[16];
+            memcpy(m, block, sizeof(m));
+            for (int i = 0; i < 8; i++) {
+                v[i] = h[i];
+                v[i + 8] = IV[i];
+            }
+            v[12] ^= t;
+            if (last) {
+                v[14] = ~v[14];
+            }
+            for (int r = 0; r < 12; r++) {
+                const uint8_t *s = SIGMA[r];
+                g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+                g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+                g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+                g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+                g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+                g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+                g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+                g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+            }
+            for (int i = 0; i < 8; i++) {
+                h[i] ^= v[i] ^ v[i + 8];
+            }
+        }
+
+    public:
+        explicit Blake2b(size_t outLen) : outLen(outLen) {
+            for (int i = 0; i < 8; i++) {
+                h[i] = IV[i];
+            }
+            h[0] ^= 0x01010000 ^ outLen;
+        }
+
+        ~Blake2b() {
+            OPENSSL_cleanse(buf, sizeof(buf));
+        }
+
+        // The last block is held back until final, which must compress it with the last-block flag
+        Blake2b &update(const void *in, size_t len) {
+            const uint8_t *p = (const uint8_t *) in;
+            while (len > 0) {
+                if (bufLen == sizeof(buf)) {
+                    t += sizeof(buf);
+                    compress(buf, false);
+                    bufLen = 0;
+                }
+                size_t take = std::min(len, sizeof(buf) - bufLen);
+                memcpy(buf + bufLen, p, take);
+                bufLen += take;
+                p += take;
+                len -= take;
+            }
+            return *this;
+        }
+
+        Blake2b &update32(uint32_t v) {
+            uint8_t bytes[4];
+            store32(bytes, v);
+            return update(bytes, sizeof(bytes));
+        }
+
+        void final(uint8_t *out) {
+            t += bufLen;
+            memset(buf + bufLen, 0, sizeof(buf) - bufLen);
+            compress(buf, true);
+            memcpy(out, h, outLen);
+        }
+};
+
+// H', the variable-length hash that expands H0 into the first blocks and the last block into the tag
+inline void blake2bLong(uint8_t *out, size_t outLen, const uint8_t *in, size_t inLen) {
+    if (outLen <= 64) {
+        Blake2b(outLen).update32(outLen).update(in, inLen).final(out);
+        return;
+    }
+    uint8_t v[64];
+    Blake2b(64).update32(outLen).update(in, inLen).final(v);
+    memcpy(out, v, 32);
+    out += 32;
+    size_t left = outLen - 32;
+    while (left > 64) {
+        Blake2b(64).update(v, 64).final(v);
+        memcpy(out, v, 32);
+        out += 32;
+        left -= 32;
+    }
+    Blake2b(left).update(v, 64).final(out);
+    OPENSSL_cleanse(v, sizeof(v));
+}
+
+// BlaMka compression G(prev ^ ref), written to next or, with withXor (passes after the first),
+// xored into it; ref and next may be the same block
+typedef void (*FillBlock)(const Block *prev, const Block *ref, Block *next, bool withXor);
+
+// Portable kernel, the shape of RFC 9106's reference code
+
+static inline uint64_t blamka(uint64_t x, uint64_t y) {
+    return x + y + 2 * (uint64_t) (uint32_t) x * (uint32_t) y;
+}
+
+static inline void gRef(uint64_t &a, uint64_t &b, uint64_t &c, uint64_t &d) {
+    a = blamka(a, b);
+    d = rotr64(d ^ a, 32);
+    c = blamka(c, d);
+    b = rotr64(b ^ c, 24);
+    a = blamka(a, b);
+    d = rotr64(d ^ a, 16);
+    c = blamka(c, d);
+    b = rotr64(b ^ c, 63);
+}
+
+// One BLAKE2 round without message words on the 16 words w[at[0]], ..., w[at[15]]
+static inline void roundRef(uint64_t *w, const uint32_t *at) {
+    gRef(w[at[0]], w[at[4]], w[at[8]], w[at[12]]);
+    gRef(w[at[1]], w[at[5]], w[at[9]], w[at[13]]);
+    gRef(w[at[2]], w[at[6]], w[at[10]], w[at[14]]);
+    gRef(w[at[3]], w[at[7]], w[at[11]], w[at[15]]);
+    gRef(w[at[0]], w[at[5]], w[at[10]], w[at[15]]);
+    gRef(w[at[1]], w[at[6]], w[at[11]], w[at[12]]);
+    gRef(w[at[2]], w[at[7]], w[at[8]], w[at[13]]);
+    gRef(w[at[3]], w[at[4]], w[at[9]], w[at[14]]);
+}
+
+static void fillBlockRef(const Block *prev, const Block *ref, Block *next, bool withXor) {
+    Block r, x;
+    for (uint32_t i = 0; i < blockWords; i++) {
+        r.v[i] = prev->v[i] ^ ref->v[i];
+        x.v[i] = withXor ? r.v[i] ^ next->v[i] : r.v[i];
+    }
+    uint32_t at[16];
+    // Rows of sixteen consecutive words, then columns of word pairs (2i, 2i + 1) of every row
+    for (uint32_t i = 0; i < 8; i++) {
+        for (uint32_t k = 0; k < 16; k++) {
+            at[k] = 16 * i + k;
+        }
+        roundRef(r.v, at);
+    }
+    for (uint32_t i = 0; i < 8; i++) {
+        for (uint32_t k = 0; k < 16; k++) {
+            at[k] = 16 * (k / 2) + 2 * i + k % 2;
+        }
+        roundRef(r.v, at);
+    }
+    for (uint32_t i = 0; i < blockWords; i++) {
+        next->v[i] = x.v[i] ^ r.v[i];
+    }
+}
+
+// SSSE3: a round is eight 2-word registers, A0 = words 0-1 ... D1 = words 14-15; rotations by
+// whole bytes are byte shuffles
+
+template<int N>
+__attribute__((target("ssse3")))
+static inline __m128i rotrSsse3(__m128i x) {
+    if constexpr (N == 32) {
+        return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+    } else if constexpr (N == 24) {
+        return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+    } else if constexpr (N == 16) {
+        return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+    } else {
+        return _mm_xor_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x));
+    }
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i blamkaSsse3(__m128i x, __m128i y) {
+    __m128i z = _mm_mul_epu32(x, y);
+    return _mm_add_epi64(_mm_add_epi64(x, y), _mm_add_epi64(z, z));
+}
+
+__attribute__((target("ssse3")))
+static inline void gSsse3(__m128i &a, __m128i &b, __m128i &c, __m128i &d) {
+    a = blamkaSsse3(a, b);
+    d = rotrSsse3<32>(_mm_xor_si128(d, a));
+    c = blamkaSsse3(c, d);
+    b = rotrSsse3<24>(_mm_xor_si128(b, c));
+    a = blamkaSsse3(a, b);
+    d = rotrSsse3<16>(_mm_xor_si128(d, a));
+    c = blamkaSsse3(c, d);
+    b = rotrSsse3<63>(_mm_xor_si128(b, c));
+}
+
+__attribute__((target("ssse3")))
+static inline void roundSsse3(__m128i &a0, __m128i &a1, __m128i &b0, __m128i &b1, __m128i &c0, __m128i &c1, __m128i &d0, __m128i &d1) {
+    gSsse3(a0, b0, c0, d0);
+    gSsse3(a1, b1, c1, d1);
+    // Diagonals: B = 5 6 7 4, C = 10 11 8 9, D = 15 12 13 14
+    __m128i t0 = _mm_alignr_epi8(b1, b0, 8), t1 = _mm_alignr_epi8(b0, b1, 8);
+    b0 = t0;
+    b1 = t1;
+    std::swap(c0, c1);
+    t0 = _mm_alignr_epi8(d1, d0, 8);
+    t1 = _mm_alignr_epi8(d0, d1, 8);
+    d0 = t1;
+    d1 = t0;
+    gSsse3(a0, b0, c0, d0);
+    gSsse3(a1, b1, c1, d1);
+    t0 = _mm_alignr_epi8(b0, b1, 8);
+    t1 = _mm_alignr_epi8(b1, b0, 8);
+    b0 = t0;
+    b1 = t1;
+    std::swap(c0, c1);
+    t0 = _mm_alignr_epi8(d0, d1, 8);
+    t1 = _mm_alignr_epi8(d1, d0, 8);
+    d0 = t1;
+    d1 = t0;
+}
+
+__attribute__((target("ssse3")))
+static void fillBlockSsse3(const Block *prev, const Block *ref, Block *next, bool withXor) {
+    __m128i s[64], x[64];
+    for (int i = 0; i < 64; i++) {
+        s[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) prev->v + i), _mm_loadu_si128((const __m128i *) ref->v + i));
+        x[i] = withXor ? _mm_xor_si128(s[i], _mm_loadu_si128((const __m128i *) next->v + i)) : s[i];
+    }
+    // s[8i + j] holds words 16i + 2j and 16i + 2j + 1
+    for (int i = 0; i < 8; i++) {
+        roundSsse3(s[8 * i], s[8 * i + 1], s[8 * i + 2], s[8 * i + 3], s[8 * i + 4], s[8 * i + 5], s[8 * i + 6], s[8 * i + 7]);
+    }
+    for (int i = 0; i < 8; i++) {
+        roundSsse3(s[i], s[8 + i], s[16 + i], s[24 + i], s[32 + i], s[40 + i], s[48 + i], s[56 + i]);
+    }
+    for (int i = 0; i < 64; i++) {
+        _mm_storeu_si128((__m128i *) next->v + i, _mm_xor_si128(s[i], x[i]));
+    }
+}
+
+// AVX2: 4-word registers, two rounds side by side; for the rows each register is a quarter of one
+// round, for the columns it holds a word pair of two neighbouring rounds
+
+template<int N>
+__attribute__((target("avx2")))
+static inline __m256i rotrAvx2(__m256i x) {
+    if constexpr (N == 32) {
+        return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+    } else if constexpr (N == 24) {
+        return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                                       3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+    } else if constexpr (N == 16) {
+        return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                                       2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+    } else {
+        return _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blamkaAvx2(__m256i x, __m256i y) {
+    __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+__attribute__((target("avx2")))
+static inline void gAvx2(__m256i &a, __m256i &b, __m256i &c, __m256i &d) {
+    a = blamkaAvx2(a, b);
+    d = rotrAvx2<32>(_mm256_xor_si256(d, a));
+    c = blamkaAvx2(c, d);
+    b = rotrAvx2<24>(_mm256_xor_si256(b, c));
+    a = blamkaAvx2(a, b);
+    d = rotrAvx2<16>(_mm256_xor_si256(d, a));
+    c = blamkaAvx2(c, d);
+    b = rotrAvx2<63>(_mm256_xor_si256(b, c));
+}
+
+// Two whole rounds, A = words 0-3 ... D = words 12-15 of each; diagonals rotate lanes in place
+__attribute__((target("avx2")))
+static inline void roundRowsAvx2(__m256i &a0, __m256i &a1, __m256i &b0, __m256i &b1, __m256i &c0, __m256i &c1, __m256i &d0, __m256i &d1) {
+    gAvx2(a0, b0, c0, d0);
+    gAvx2(a1, b1, c1, d1);
+    b0 = _mm256_permute4x64_epi64(b0, _MM_SHUFFLE(0, 3, 2, 1));
+    c0 = _mm256_permute4x64_epi64(c0, _MM_SHUFFLE(1, 0, 3, 2));
+    d0 = _mm256_permute4x64_epi64(d0, _MM_SHUFFLE(2, 1, 0, 3));
+    b1 = _mm256_permute4x64_epi64(b1, _MM_SHUFFLE(0, 3, 2, 1));
+    c1 = _mm256_permute4x64_epi64(c1, _MM_SHUFFLE(1, 0, 3, 2));
+    d1 = _mm256_permute4x64_epi64(d1, _MM_SHUFFLE(2, 1, 0, 3));
+    gAvx2(a0, b0, c0, d0);
+    gAvx2(a1, b1, c1, d1);
+    b0 = _mm256_permute4x64_epi64(b0, _MM_SHUFFLE(2, 1, 0, 3));
+    c0 = _mm256_permute4x64_epi64(c0, _MM_SHUFFLE(1, 0, 3, 2));
+    d0 = _mm256_permute4x64_epi64(d0, _MM_SHUFFLE(0, 3, 2, 1));
+    b1 = _mm256_permute4x64_epi64(b1, _MM_SHUFFLE(2, 1, 0, 3));
+    c1 = _mm256_permute4x64_epi64(c1, _MM_SHUFFLE(1, 0, 3, 2));
+    d1 = _mm256_permute4x64_epi64(d1, _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+// Two rounds interleaved, each register words (2k, 2k + 1) of both; diagonals swap between registers
+__attribute__((target("avx2")))
+static inline void roundColumnsAvx2(__m256i &a0, __m256i &a1, __m256i &b0, __m256i &b1, __m256i &c0, __m256i &c1, __m256i &d0, __m256i &d1) {
+    gAvx2(a0, b0, c0, d0);
+    gAvx2(a1, b1, c1, d1);
+    // B = 5 6 | 7 4, C = 10 11 | 8 9, D = 15 12 | 13 14
+    __m256i t0 = _mm256_blend_epi32(b0, b1, 0xcc), t1 = _mm256_blend_epi32(b0, b1, 0x33);
+    b1 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));
+    b0 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));
+    std::swap(c0, c1);
+    t0 = _mm256_blend_epi32(d0, d1, 0xcc);
+    t1 = _mm256_blend_epi32(d0, d1, 0x33);
+    d0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));
+    d1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));
+    gAvx2(a0, b0, c0, d0);
+    gAvx2(a1, b1, c1, d1);
+    t0 = _mm256_blend_epi32(b0, b1, 0xcc);
+    t1 = _mm256_blend_epi32(b0, b1, 0x33);
+    b0 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));
+    b1 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));
+    std::swap(c0, c1);
+    t0 = _mm256_blend_epi32(d0, d1, 0xcc);
+    t1 = _mm256_blend_epi32(d0, d1, 0x33);
+    d0 = _mm256_permute4x64_epi64(t1, _MM_SHUFFLE(2, 3, 0, 1));
+    d1 = _mm256_permute4x64_epi64(t0, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+__attribute__((target("avx2")))
+static void fillBlockAvx2(const Block *prev, const Block *ref, Block *next, bool withXor) {
+    __m256i s[32], x[32];
+    for (int i = 0; i < 32; i++) {
+        s[i] = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) prev->v + i), _mm256_loadu_si256((const __m256i *) ref->v + i));
+        x[i] = withXor ? _mm256_xor_si256(s[i], _mm256_loadu_si256((const __m256i *) next->v + i)) : s[i];
+    }
+    // s[k] holds words 4k to 4k + 3
+    for (int i = 0; i < 4; i++) {
+        roundRowsAvx2(s[8 * i], s[8 * i + 4], s[8 * i + 1], s[8 * i + 5], s[8 * i + 2], s[8 * i + 6], s[8 * i + 3], s[8 * i + 7]);
+    }
+    for (int i = 0; i < 4; i++) {
+        roundColumnsAvx2(s[i], s[4 + i], s[8 + i], s[12 + i], s[16 + i], s[20 + i], s[24 + i], s[28 + i]);
+    }
+    for (int i = 0; i < 32; i++) {
+        _mm256_storeu_si256((__m256i *) next->v + i, _mm256_xor_si256(s[i], x[i]));
+    }
+}
+
+// AVX-512F: 8-word registers, four rounds at a time; each 256-bit half of a register runs the AVX2
+// layout of one round, and the halves and quarters are regrouped before and after
+
+__attribute__((target("avx512f")))
+static inline __m512i blamkaAvx512(__m512i x, __m512i y) {
+    __m512i z = _mm512_mul_epu32(x, y);
+    return _mm512_add_epi64(_mm512_add_epi64(x, y), _mm512_add_epi64(z, z));
+}
+
+__attribute__((target("avx512f")))
+static inline void gAvx512(__m512i &a, __m512i &b, __m512i &c, __m512i &d) {
+    a = blamkaAvx512(a, b);
+    d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 32);
+    c = blamkaAvx512(c, d);
+    b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 24);
+    a = blamkaAvx512(a, b);
+    d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 16);
+    c = blamkaAvx512(c, d);
+    b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 63);
+}
+
+__attribute__((target("avx512f")))
+static inline void roundAvx512(__m512i &a0, __m512i &b0, __m512i &c0, __m512i &d0, __m512i &a1, __m512i &b1, __m512i &c1, __m512i &d1) {
+    gAvx512(a0, b0, c0, d0);
+    gAvx512(a1, b1, c1, d1);
+    b0 = _mm512_permutex_epi64(b0, _MM_SHUFFLE(0, 3, 2, 1));
+    c0 = _mm512_permutex_epi64(c0, _MM_SHUFFLE(1, 0, 3, 2));
+    d0 = _mm512_permutex_epi64(d0, _MM_SHUFFLE(2, 1, 0, 3));
+    b1 = _mm512_permutex_epi64(b1, _MM_SHUFFLE(0, 3, 2, 1));
+    c1 = _mm512_permutex_epi64(c1, _MM_SHUFFLE(1, 0, 3, 2));
+    d1 = _mm512_permutex_epi64(d1, _MM_SHUFFLE(2, 1, 0, 3));
+    gAvx512(a0, b0, c0, d0);
+    gAvx512(a1, b1, c1, d1);
+    b0 = _mm512_permutex_epi64(b0, _MM_SHUFFLE(2, 1, 0, 3));
+    c0 = _mm512_permutex_epi64(c0, _MM_SHUFFLE(1, 0, 3, 2));
+    d0 = _mm512_permutex_epi64(d0, _MM_SHUFFLE(0, 3, 2, 1));
+    b1 = _mm512_permutex_epi64(b1, _MM_SHUFFLE(2, 1, 0, 3));
+    c1 = _mm512_permutex_epi64(c1, _MM_SHUFFLE(1, 0, 3, 2));
+    d1 = _mm512_permutex_epi64(d1, _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+// Low halves of both into a, high halves into b; its own inverse
+__attribute__((target("avx512f")))
+static inline void swapHalvesAvx512(__m512i &a, __m512i &b) {
+    __m512i t0 = _mm512_shuffle_i64x2(a, b, _MM_SHUFFLE(1, 0, 1, 0));
+    __m512i t1 = _mm512_shuffle_i64x2(a, b, _MM_SHUFFLE(3, 2, 3, 2));
+    a = t0;
+    b = t1;
+}
+
+// Word pairs of four rounds in two registers to one round per 256-bit half; inverse with Undo
+template<bool Undo>
+__attribute__((target("avx512f")))
+static inline void swapQuartersAvx512(__m512i &a, __m512i &b) {
+    const __m512i order = _mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7);
+    if (!Undo) {
+        swapHalvesAvx512(a, b);
+    }
+    a = _mm512_permutexvar_epi64(order, a);
+    b = _mm512_permutexvar_epi64(order, b);
+    if (Undo) {
+        swapHalvesAvx512(a, b);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void fillBlockAvx512(const Block *prev, const Block *ref, Block *next, bool withXor) {
+    __m512i s[16], x[16];
+    for (int i = 0; i < 16; i++) {
+        s[i] = _mm512_xor_si512(_mm512_loadu_si512((const __m512i *) prev->v + i), _mm512_loadu_si512((const __m512i *) ref->v + i));
+        x[i] = withXor ? _mm512_xor_si512(s[i], _mm512_loadu_si512((const __m512i *) next->v + i)) : s[i];
+    }
+    // s[k] holds words 8k to 8k + 7, so each round of the rows is two neighbouring registers
+    for (int i = 0; i < 2; i++) {
+        __m512i *r = s + 8 * i;
+        swapHalvesAvx512(r[0], r[2]);
+        swapHalvesAvx512(r[1], r[3]);
+        swapHalvesAvx512(r[4], r[6]);
+        swapHalvesAvx512(r[5], r[7]);
+        roundAvx512(r[0], r[2], r[1], r[3], r[4], r[6], r[5], r[7]);
+        swapHalvesAvx512(r[0], r[2]);
+        swapHalvesAvx512(r[1], r[3]);
+        swapHalvesAvx512(r[4], r[6]);
+        swapHalvesAvx512(r[5], r[7]);
+    }
+    // s[2m + h] holds word pair m of rounds 4h to 4h + 3 of the columns
+    for (int i = 0; i < 2; i++) {
+        for (int m = 0; m < 8; m += 2) {
+            swapQuartersAvx512<false>(s[2 * m + i], s[2 * m + 2 + i]);
+        }
+        roundAvx512(s[i], s[4 + i], s[8 + i], s[12 + i], s[2 + i], s[6 + i], s[10 + i], s[14 + i]);
+        for (int m = 0; m < 8; m += 2) {
+            swapQuartersAvx512<true>(s[2 * m + i], s[2 * m + 2 + i]);
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        _mm512_storeu_si512((__m512i *) next->v + i, _mm512_xor_si512(s[i], x[i]));
+    }
+}
+
+inline FillBlock kernel(Isa isa) {
+    switch (isa) {
+        case REF: return fillBlockRef;
+        case SSSE3: return fillBlockSsse3;
+        case AVX2: return fillBlockAvx2;
+        case AVX512: return fillBlockAvx512;
+    }
+    return fillBlockRef;
+}
+
+// One hash in progress: the block matrix and the geometry the indexing works from
+struct Instance {
+    Block *memory;
+    uint32_t passes;
+    uint32_t memoryBlocks;
+    uint32_t segmentLength;
+    uint32_t laneLength;
+    uint32_t lanes;
+    argon2_type type;
+    uint32_t version;
+    FillBlock fill;
+};
+
+// Position of the reference block within its lane for block index of the segment
+static inline uint32_t indexAlpha(const Instance &in, uint32_t pass, uint32_t slice, uint32_t index, uint32_t pseudoRand, bool sameLane) {
+    uint32_t area;
+    if (pass == 0) {
+        if (slice == 0) {
+            area = index - 1;
+        } else if (sameLane) {
+            area = slice * in.segmentLength + index - 1;
+        } else {
+            area = slice * in.segmentLength + (index == 0 ? -1 : 0);
+        }
+    } else if (sameLane) {
+        area = in.laneLength - in.segmentLength + index - 1;
+    } else {
+        area = in.laneLength - in.segmentLength + (index == 0 ? -1 : 0);
+    }
+    uint64_t rel = pseudoRand;
+    rel = rel * rel >> 32;
+    rel = area - 1 - ((uint64_t) area * rel >> 32);
+    uint32_t start = pass != 0 && slice != syncPoints - 1 ? (slice + 1) * in.segmentLength : 0;
+    return (uint32_t) ((start + rel) % in.laneLength);
+}
+
+static void fillSegment(const Instance &in, uint32_t pass, uint32_t lane, uint32_t slice) {
+    // Argon2id takes data-independent references for the first half of the first pass only
+    bool independent = in.type == Argon2_i || (in.type == Argon2_id && pass == 0 && slice < syncPoints / 2);
+    Block zero = {}, input = {}, address = {};
+    auto nextAddresses = [&]() {
+        input.v[6]++;
+        in.fill(&zero, &input, &address, false);
+        in.fill(&zero, &address, &address, false);
+    };
+    if (independent) {
+        input.v[0] = pass;
+        input.v[1] = lane;
+        input.v[2] = slice;
+        input.v[3] = in.memoryBlocks;
+        input.v[4] = in.passes;
+        input.v[5] = in.type;
+    }
+    uint32_t start = 0;
+    if (pass == 0 && slice == 0) {
+        start = 2;
+        if (independent) {
+            nextAddresses();
+        }
+    }
+    uint32_t curr = lane * in.laneLength + slice * in.segmentLength + start;
+    uint32_t prev = curr % in.laneLength == 0 ? curr + in.laneLength - 1 : curr - 1;
+    for (uint32_t i = start; i < in.segmentLength; i++, curr++, prev++) {
+        if (curr % in.laneLength == 1) {
+            prev = curr - 1;
+        }
+        uint64_t pseudoRand;
+        if (independent) {
+            if (i % addressesInBlock == 0) {
+                nextAddresses();
+            }
+            pseudoRand = address.v[i % addressesInBlock];
+        } else {
+            pseudoRand = in.memory[prev].v[0];
+        }
+        uint32_t refLane = pass == 0 && slice == 0 ? lane : (uint32_t) ((pseudoRand >> 32) % in.lanes);
+        uint32_t refIndex = indexAlpha(in, pass, slice, i, (uint32_t) pseudoRand, refLane == lane);
+        const Block *ref = in.memory + (size_t) in.laneLength * refLane + refIndex;
+        in.fill(in.memory + prev, ref, in.memory + curr, in.version != ARGON2_VERSION_10 && pass != 0);
+    }
+}
+
+static int validate(const argon2_context *ctx, argon2_type type) {
+    if (ctx->out == NULL) {
+        return ARGON2_OUTPUT_PTR_NULL;
+    }
+    if (ctx->outlen < 4) {
+        return ARGON2_OUTPUT_TOO_SHORT;
+    }
+    if (ctx->pwd == NULL && ctx->pwdlen != 0) {
+        return ARGON2_PWD_PTR_MISMATCH;
+    }
+    if (ctx->salt == NULL && ctx->saltlen != 0) {
+        return ARGON2_SALT_PTR_MISMATCH;
+    }
+    if (ctx->secret == NULL && ctx->secretlen != 0) {
+        return ARGON2_SECRET_PTR_MISMATCH;
+    }
+    if (ctx->ad == NULL && ctx->adlen != 0) {
+        return ARGON2_AD_PTR_MISMATCH;
+    }
+    if (ctx->saltlen < 8) {
+        return ARGON2_SALT_TOO_SHORT;
+    }
+    if (ctx->t_cost < 1) {
+        return ARGON2_TIME_TOO_SMALL;
+    }
+    if (ctx->lanes < 1) {
+        return ARGON2_LANES_TOO_FEW;
+    }
+    if (ctx->lanes > 0xffffff) {
+        return ARGON2_LANES_TOO_MANY;
+    }
+    if (ctx->m_cost < 2 * syncPoints * ctx->lanes) {
+        return ARGON2_MEMORY_TOO_LITTLE;
+    }
+    if (ctx->threads < 1) {
+        return ARGON2_THREADS_TOO_FEW;
+    }
+    if (ctx->threads > 0xffffff) {
+        return ARGON2_THREADS_TOO_MANY;
+    }
+    if (ctx->version != ARGON2_VERSION_10 && ctx->version != ARGON2_VERSION_13) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+    if (type != Argon2_d && type != Argon2_i && type != Argon2_id) {
+        return ARGON2_INCORRECT_TYPE;
+    }
+    return ARGON2_OK;
+}
+
+// argon2_ctx with the compression kernel given; same inputs, same outputs, same error codes for
+// bad parameters, and the same allocation callbacks, called on this thread
+// Lanes of each slice run on min(threads, lanes) threads, this one included
+inline int ctx(argon2_context *context, argon2_type type, Isa isa) {
+    int status = validate(context, type);
+    if (status != ARGON2_OK) {
+        return status;
+    }
+    Instance in;
+    in.passes = context->t_cost;
+    in.lanes = context->lanes;
+    in.segmentLength = context->m_cost / (in.lanes * syncPoints);
+    in.laneLength = in.segmentLength * syncPoints;
+    in.memoryBlocks = in.laneLength * in.lanes;
+    in.type = type;
+    in.version = context->version;
+    in.fill = kernel(isa);
+
+    size_t bytes = (size_t) in.memoryBlocks * sizeof(Block);
+    uint8_t *memory = NULL;
+    if (context->allocate_cbk != NULL) {
+        if (context->allocate_cbk(&memory, bytes) != ARGON2_OK) {
+            memory = NULL;
+        }
+    } else if (posix_memalign((void **) &memory, alignof(Block), bytes) != 0) {
+        memory = NULL;
+    }
+    if (memory == NULL) {
+        return ARGON2_MEMORY_ALLOCATION_ERROR;
+    }
+    in.memory = (Block *) memory;
+
+    // H0 over every input, then the first two blocks of each lane from it
+    uint8_t seed[prehashSeedLength];
+    Blake2b h0(64);
+    h0.update32(context->lanes).update32(context->outlen).update32(context->m_cost).update32(context->t_cost)
+      .update32(context->version).update32(type)
+      .update32(context->pwdlen).update(context->pwd, context->pwdlen)
+      .update32(context->saltlen).update(context->salt, context->saltlen)
+      .update32(context->secretlen).update(context->secret, context->secretlen)
+      .update32(context->adlen).update(context->ad, context->adlen);
+    h0.final(seed);
+    if ((context->flags & ARGON2_FLAG_CLEAR_PASSWORD) && context->pwd != NULL) {
+        OPENSSL_cleanse(context->pwd, context->pwdlen);
+        context->pwdlen = 0;
+    }
+    if ((context->flags & ARGON2_FLAG_CLEAR_SECRET) && context->secret != NULL) {
+        OPENSSL_cleanse(context->secret, context->secretlen);
+        context->secretlen = 0;
+    }
+    for (uint32_t lane = 0; lane < in.lanes; lane++) {
+        for (uint32_t b = 0; b < 2; b++) {
+            store32(seed + 64, b);
+            store32(seed + 68, lane);
+            blake2bLong((uint8_t *) &in.memory[(size_t) lane * in.laneLength + b], sizeof(Block), seed, sizeof(seed));
+        }
+    }
+    OPENSSL_cleanse(seed, sizeof(seed));
+
+    uint32_t threads = std::min(context->threads, in.lanes);
+    for (uint32_t pass = 0; pass < in.passes; pass++) {
+        for (uint32_t slice = 0; slice < syncPoints; slice++) {
+            auto work = [&](uint32_t first) {
+                for (uint32_t lane = first; lane < in.lanes; lane += threads) {
+                    fillSegment(in, pass, lane, slice);
+                }
+            };
+            std::vector<std::thread> workers;
+            for (uint32_t t = 1; t < threads; t++) {
+                workers.emplace_back(work, t);
+            }
+            work(0);
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+    }
+
+    // The tag is H' of the last blocks of every lane xored together
+    Block last = in.memory[in.laneLength - 1];
+    for (uint32_t lane = 1; lane < in.lanes; lane++) {
+        const Block &b = in.memory[(size_t) lane * in.laneLength + in.laneLength - 1];
+        for (uint32_t i = 0; i < blockWords; i++) {
+            last.v[i] ^= b.v[i];
+        }
+    }
+    blake2bLong(context->out, context->outlen, (const uint8_t *) last.v, sizeof(last));
+    OPENSSL_cleanse(&last, sizeof(last));
+    OPENSSL_cleanse(memory, bytes);
+    if (context->free_cbk != NULL) {
+        context->free_cbk(memory, bytes);
+    } else {
+        free(memory);
+    }
+    return ARGON2_OK;
+}
+
+}  // namespace argon2_core
+
+#endif // ARGON2_CORE_HPP
@@ -0,0 +1,260 @@
+#ifndef ATTACK_HPP
+#define ATTACK_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <ostream>
+#include <unordered_map>
+#include <cassert>
+#include "framework.hpp"
+
+// Attacker-side numbers for one run of a wordlist against a file of leaked hashes
+struct AttackResult {
+    size_t targets = 0;
+    size_t groups = 0;       // Distinct (parameters, salt) sets, each costing one derivation per guess
+    size_t candidates = 0;
+    unsigned int threads = 0;
+    size_t cracked = 0;
+    uint64_t guesses = 0;    // Derivations actually computed; fully cracked groups stop early
+    uint64_t steals = 0;
+    Sample time;
+
+    double guessesPerSecond() const {
+        return guesses / time.wall;
+    }
+
+    // Wall time and core-seconds spent per cracked hash; 0 when nothing was cracked
+    double wallPerCrack() const {
+        return cracked ? time.wall / cracked : 0;
+    }
+
+    double cpuPerCrack() const {
+        return cracked ? time.processCpu / cracked : 0;
+    }
+
+    static const char *csvHeader() {
+        return "Targets,Groups,Candidates,Threads,Cracked,Guesses,Steals,Time(s),ProcessCpu(s),Guesses/s,WallPerCrack(s),CpuPerCrack(s)";
+    }
+
+    void writeCsv(std::ostream &f) const {
+        f << targets << "," << groups << "," << candidates << "," << threads << "," << cracked << "," << guesses << ","
+          << steals << "," << time.wall << "," << time.processCpu << "," << guessesPerSecond() << ","
+          << wallPerCrack() << "," << cpuPerCrack();
+    }
+};
+
+// Dictionary attack on many PHC hashes at once
+// Targets sharing an algorithm, parameters and salt form a group: one derivation per candidate checks
+// all of them through a digest lookup, so unsalted hashes cost one guess per candidate in total
+// The candidate x group space is cut into chunks; each thread starts with a contiguous share and, once
+// it runs dry, steals the upper half of the largest share left
+class DictionaryAttack {
+    private:
+        struct Group {
+            PhcRecord params;  // Everything the targets share; its digest is unused
+            std::unordered_map<std::string_view, std::vector<size_t>> digests;  // Raw digest to targets
+            std::atomic<size_t> remaining{0};  // Targets not cracked yet
+        };
+
+        // Chunk indices a thread still owns, [begin, end)
+        struct Share {
+            std::mutex lock;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        HashBenchmark &algorithm;
+        std::vector<std::string> targets;
+        std::vector<std::string> digests;  // Raw digest per target, the storage the group maps point into
+        std::vector<std::unique_ptr<Group>> groups;
+        std::vector<std::string> found;    // Cracked password per target
+        std::vector<bool> isCracked;
+        std::mutex foundLock;
+
+        void crack(Group &group, const std::vector<size_t> &hits, std::string_view password) {
+            std::lock_guard<std::mutex> guard(foundLock);
+            for (size_t target : hits) {
+                if (!isCracked[target]) {
+                    isCracked[target] = true;
+                    found[target].assign(password);
+                    group.remaining--;
+                }
+            }
+        }
+
+        // Take the next chunk of a share, or steal half of the fullest other share into it
+        bool nextChunk(std::vector<Share> &shares, size_t self, size_t &chunk, std::atomic<uint64_t> &steals) {
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> guard(shares[self].lock);
+                    if (shares[self].begin < shares[self].end) {
+                        chunk = shares[self].begin++;
+                        return true;
+                    }
+                }
+                size_t victim = self, most = 0;
+                for (size_t i = 0; i < shares.size(); i++) {
+                    std::lock_guard<std::mutex> guard(shares[i].lock);
+                    if (i != self && shares[i].end - shares[i].begin > most) {
+                        most = shares[i].end - shares[i].begin;
+                        victim = i;
+                    }
+                }
+                if (victim == self) {
+                    return false;
+                }
+                // Lock in index order so two thieves robbing each other cannot deadlock
+                std::unique_lock<std::mutex> first(shares[std::min(self, victim)].lock);
+                std::unique_lock<std::mutex> second(shares[std::max(self, victim)].lock);
+                Share &v = shares[victim];
+                if (v.end - v.begin < 2) {
+                    if (v.begin < v.end) {
+                        chunk = v.begin++;
+                        return true;
+                    }
+                    continue;
+                }
+                size_t mid = v.begin + (v.end - v.begin) / 2;
+                shares[self].begin = mid;
+                shares[self].end = v.end;
+                v.end = mid;
+                steals++;
+            }
+        }
+
+    public:
+        // One PHC string per line; every line must decode
+        DictionaryAttack(HashBenchmark &algorithm, const std::string &targetFile) : algorithm(algorithm) {
+            std::ifstream file(targetFile);
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty()) {
+                    targets.push_back(line);
+                }
+            }
+            digests.resize(targets.size());
+            found.resize(targets.size());
+            isCracked.resize(targets.size());
+
+            std::unordered_map<std::string, size_t> index;
+            char key[PHC_MAX_LENGTH];
+            for (size_t i = 0; i < targets.size(); i++) {
+                PhcRecord rec;
+                assert(phc::decode(targets[i], rec));
+                digests[i].assign((const char *) rec.hash, rec.hashLen);
+                // The group key is the canonical string without the digest, plus the digest length
+                size_t hashLen = rec.hashLen;
+                rec.hashLen = 0;
+                std::string name(key, phc::encode(rec, key, sizeof(key)));
+                name += std::to_string(hashLen);
+                auto [it, added] = index.emplace(name, groups.size());
+                if (added) {
+                    groups.emplace_back(new Group());
+                    groups.back()->params = rec;
+                    groups.back()->params.hashLen = hashLen;
+                }
+                Group &group = *groups[it->second];
+                group.digests[digests[i]].push_back(i);
+                group.remaining++;
+            }
+        }
+
+        size_t targetCount() const {
+            return targets.size();
+        }
+
+        size_t groupCount() const {
+            return groups.size();
+        }
+
+        // Password found for target i, empty if it was not cracked
+        std::string_view password(size_t i) const {
+            return found[i];
+        }
+
+        const std::string &target(size_t i) const {
+            return targets[i];
+        }
+
+        // Run the wordlist against every target on a pool of threads, chunk candidates per unit of work
+        // Earlier results are cleared; non-reentrant algorithms always run on one thread
+        AttackResult run(const Corpus &wordlist, unsigned int threads, size_t chunk = 16) {
+            if (!algorithm.reentrant()) {
+                threads = 1;
+            }
+            for (size_t i = 0; i < targets.size(); i++) {
+                found[i].clear();
+                isCracked[i] = false;
+            }
+            for (auto &group : groups) {
+                size_t count = 0;
+                for (auto &[digest, hits] : group->digests) {
+                    count += hits.size();
+                }
+                group->remaining = count;
+            }
+
+            size_t chunksPerGroup = (wordlist.size() + chunk - 1) / chunk;
+            size_t chunks = chunksPerGroup * groups.size();
+            std::vector<Share> shares(threads);
+            for (unsigned int i = 0; i < threads; i++) {
+                shares[i].begin = chunks * i / threads;
+                shares[i].end = chunks * (i + 1) / threads;
+            }
+
+            std::atomic<uint64_t> guesses(0), steals(0);
+            Stopwatch watch;
+            watch.start();
+            std::vector<std::thread> workers;
+            for (unsigned int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    uint8_t digest[PhcRecord::maxHash];
+                    uint64_t done = 0;
+                    size_t unit;
+                    while (nextChunk(shares, t, unit, steals)) {
+                        Group &group = *groups[unit / chunksPerGroup];
+                        size_t begin = unit % chunksPerGroup * chunk;
+                        size_t end = std::min(begin + chunk, wordlist.size());
+                        for (size_t i = begin; i < end && group.remaining > 0; i++) {
+                            std::string_view candidate = wordlist[i];
+                            // A candidate that cannot produce this group's digest, e.g. the wrong length
+                            // for plaintext, is not a guess
+                            if (!algorithm.phcDerive(group.params, candidate, digest)) {
+                                continue;
+                            }
+                            done++;
+                            auto hit = group.digests.find(std::string_view((const char *) digest, group.params.hashLen));
+                            if (hit != group.digests.end()) {
+                                crack(group, hit->second, candidate);
+                            }
+                        }
+                    }
+                    guesses += done;
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+
+            AttackResult result;
+            result.time = watch.stop();
+            result.targets = targets.size();
+            result.groups = groups.size();
+            result.candidates = wordlist.size();
+            result.threads = threads;
+            result.guesses = guesses;
+            result.steals = steals;
+            for (size_t i = 0; i < targets.size(); i++) {
+                result.cracked += isCracked[i];
+            }
+            return result;
+        }
+};
+
+#endif // ATTACK_HPP
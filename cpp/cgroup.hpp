@@ -0,0 +1,223 @@
+#ifndef CGROUP_HPP
+#define CGROUP_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <functional>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// What the kernel accounted for one configuration run in its own cgroup
+// Fields the host cannot provide stay at -1 and leave their csv column empty
+struct CgroupUsage {
+    bool isolated = false;          // The child was charged to a fresh cgroup
+    long long memoryPeak = -1;      // memory.peak, bytes
+    bool hugetlbCharged = false;    // memory.peak includes hugetlb pages (memory_hugetlb_accounting)
+    long long maxRss = -1;          // The child's ru_maxrss from wait4, KiB; never includes hugetlb
+    long long cpuUsage = -1;        // cpu.stat, microseconds
+    long long cpuUser = -1;
+    long long cpuSystem = -1;
+    long long nrThrottled = -1;
+    long long throttledUsec = -1;
+
+    static const char *csvHeader() {
+        return "MemoryPeak(B),HugetlbCharged,MaxRSS(KB),CpuUsage(us),CpuUser(us),CpuSystem(us),Throttled,Throttled(us)";
+    }
+
+    void writeCsv(std::ostream &f) const {
+        auto field = [&](long long v) {
+            if (v >= 0) {
+                f << v;
+            }
+        };
+        field(memoryPeak);
+        f << "," << (memoryPeak >= 0 ? hugetlbCharged : 0) << ",";
+        field(maxRss);
+        f << ",";
+        field(cpuUsage);
+        f << ",";
+        field(cpuUser);
+        f << ",";
+        field(cpuSystem);
+        f << ",";
+        field(nrThrottled);
+        f << ",";
+        field(throttledUsec);
+    }
+};
+
+// Runs each measured configuration in a forked child inside its own transient cgroup v2 group,
+// then reads the kernel's peak memory and CPU accounting for exactly that child; nothing polls
+// while it runs. Controllers the parent group can delegate (memory, cpu, hugetlb) are enabled once
+// and put back on exit. Without a usable cgroup v2 hierarchy the child still runs, and only
+// ru_maxrss is reported
+class CgroupRunner {
+    private:
+        std::string base;      // The cgroup v2 directory this process lives in, "" if there is none
+        bool hugetlbCharged = false;
+        std::vector<std::string> enabled;
+        unsigned int runs = 0;
+
+        static std::string readFile(const std::string &path) {
+            std::ifstream file(path);
+            std::stringstream content;
+            content << file.rdbuf();
+            return content.str();
+        }
+
+        static bool writeFile(const std::string &path, const std::string &value) {
+            std::ofstream file(path);
+            file << value;
+            file.close();
+            return !file.fail();
+        }
+
+        CgroupRunner() {
+            // Mount point of the cgroup2 hierarchy; field 5 of mountinfo, fstype after the " - "
+            std::ifstream mountinfo("/proc/self/mountinfo");
+            std::string line, mount;
+            while (std::getline(mountinfo, line)) {
+                size_t dash = line.find(" - cgroup2 ");
+                if (dash == std::string::npos) {
+                    continue;
+                }
+                std::istringstream fields(line);
+                std::string field;
+                for (int i = 0; i < 5; i++) {
+                    fields >> field;
+                }
+                mount = field;
+                hugetlbCharged = line.find("memory_hugetlb_accounting", dash) != std::string::npos;
+                break;
+            }
+            std::ifstream self("/proc/self/cgroup");
+            std::string path;
+            while (std::getline(self, line)) {
+                if (line.compare(0, 3, "0::") == 0) {
+                    path = line.substr(3);
+                }
+            }
+            if (mount.empty() || path.empty()) {
+                return;
+            }
+            base = mount + (path == "/" ? "" : path);
+            // Fails with EBUSY below the root while this group has processes of its own; the
+            // children then get only what is already delegated
+            std::istringstream controllers(readFile(base + "/cgroup.controllers"));
+            std::string active = readFile(base + "/cgroup.subtree_control");
+            std::string controller;
+            while (controllers >> controller) {
+                if ((controller == "memory" || controller == "cpu" || controller == "hugetlb")
+                        && active.find(controller) == std::string::npos
+                        && writeFile(base + "/cgroup.subtree_control", "+" + controller)) {
+                    enabled.push_back(controller);
+                }
+            }
+        }
+
+        ~CgroupRunner() {
+            for (const std::string &controller : enabled) {
+                writeFile(base + "/cgroup.subtree_control", "-" + controller);
+            }
+        }
+
+        static long long statField(const std::string &stat, const std::string &key) {
+            std::istringstream lines(stat);
+            std::string name;
+            long long value;
+            while (lines >> name >> value) {
+                if (name == key) {
+                    return value;
+                }
+            }
+            return -1;
+        }
+
+    public:
+        CgroupRunner(const CgroupRunner &) = delete;
+        CgroupRunner &operator=(const CgroupRunner &) = delete;
+
+        static CgroupRunner &instance() {
+            static CgroupRunner runner;
+            return runner;
+        }
+
+        // Run fn in a child process and cgroup; whatever fn writes to its stream is returned
+        std::string run(const std::function<void(std::ostream &)> &fn, CgroupUsage &usage) {
+            usage = CgroupUsage();
+            std::string group;
+            if (!base.empty()) {
+                group = base + "/hashbench-" + std::to_string(getpid()) + "-" + std::to_string(runs++);
+                if (mkdir(group.c_str(), 0755) != 0) {
+                    group.clear();
+                }
+            }
+            int pipefd[2];
+            assert(pipe(pipefd) == 0);
+            pid_t pid = fork();
+            assert(pid >= 0);
+            if (pid == 0) {
+                close(pipefd[0]);
+                // Join before doing any work, so every page and CPU cycle of the run is charged here
+                if (!group.empty()) {
+                    writeFile(group + "/cgroup.procs", std::to_string(getpid()));
+                }
+                std::ostringstream out;
+                fn(out);
+                std::string row = out.str();
+                for (size_t done = 0; done < row.size(); ) {
+                    ssize_t n = write(pipefd[1], row.data() + done, row.size() - done);
+                    if (n <= 0 && errno != EINTR) {
+                        break;
+                    }
+                    done += n > 0 ? n : 0;
+                }
+                _exit(0);
+            }
+            close(pipefd[1]);
+            std::string row;
+            char buf[4096];
+            ssize_t n;
+            while ((n = read(pipefd[0], buf, sizeof(buf))) != 0) {
+                if (n > 0) {
+                    row.append(buf, n);
+                } else if (errno != EINTR) {
+                    break;
+                }
+            }
+            close(pipefd[0]);
+            struct rusage ru;
+            int status;
+            while (wait4(pid, &status, 0, &ru) < 0 && errno == EINTR) {}
+            usage.maxRss = ru.ru_maxrss;
+            if (!group.empty()) {
+                std::string peak = readFile(group + "/memory.peak");
+                if (!peak.empty()) {
+                    usage.memoryPeak = atoll(peak.c_str());
+                    usage.hugetlbCharged = hugetlbCharged;
+                }
+                std::string stat = readFile(group + "/cpu.stat");
+                usage.cpuUsage = statField(stat, "usage_usec");
+                usage.cpuUser = statField(stat, "user_usec");
+                usage.cpuSystem = statField(stat, "system_usec");
+                usage.nrThrottled = statField(stat, "nr_throttled");
+                usage.throttledUsec = statField(stat, "throttled_usec");
+                usage.isolated = usage.cpuUsage > 0;
+                // The group can stay populated for a moment after the reap
+                for (int i = 0; i < 100 && rmdir(group.c_str()) != 0 && errno == EBUSY; i++) {
+                    usleep(1000);
+                }
+            }
+            return row;
+        }
+};
+
+#endif // CGROUP_HPP
\ No newline at end of file
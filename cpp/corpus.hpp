@@ -0,0 +1,103 @@
+#ifndef CORPUS_HPP
+#define CORPUS_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A wordlist mapped read-only once per process, with every line reachable as a string_view
+// Lines split on '\n' exactly as std::getline does; nothing is copied out of the mapping
+class Corpus {
+    private:
+        const char *data = NULL;
+        size_t bytes = 0;
+        // Offset of every line, then one past the last line's terminator, so line i spans
+        // starts[i] .. starts[i + 1] - 1; 8 bytes a line instead of a string_view's 16
+        std::vector<uint64_t> starts;
+
+        Corpus(const std::string &path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            assert(fd >= 0);
+            struct stat st;
+            assert(fstat(fd, &st) == 0);
+            bytes = st.st_size;
+            if (bytes > 0) {
+                void *mem = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+                assert(mem != MAP_FAILED);
+                madvise(mem, bytes, MADV_WILLNEED);
+                data = (const char *) mem;
+            }
+            close(fd);
+
+            starts.reserve(bytes / 8 + 1);
+            uint64_t pos = 0;
+            while (pos < bytes) {
+                starts.push_back(pos);
+                const char *end = (const char *) memchr(data + pos, '\n', bytes - pos);
+                // An unterminated last line gets a virtual terminator just past the end
+                pos = end != NULL ? end - data + 1 : bytes + 1;
+            }
+            starts.push_back(pos);
+            starts.shrink_to_fit();
+        }
+
+    public:
+        Corpus(const Corpus &) = delete;
+        Corpus &operator=(const Corpus &) = delete;
+
+        ~Corpus() {
+            if (data != NULL) {
+                munmap((void *) data, bytes);
+            }
+        }
+
+        // The corpus for a file, mapped on first use and shared by every later caller
+        static const Corpus &load(const std::string &path) {
+            static std::mutex lock;
+            static std::map<std::string, std::unique_ptr<Corpus>> loaded;
+            std::lock_guard<std::mutex> guard(lock);
+            std::unique_ptr<Corpus> &corpus = loaded[path];
+            if (!corpus) {
+                corpus.reset(new Corpus(path));
+            }
+            return *corpus;
+        }
+
+        size_t size() const {
+            return starts.size() - 1;
+        }
+
+        std::string_view operator[](size_t i) const {
+            return std::string_view(data + starts[i], starts[i + 1] - starts[i] - 1);
+        }
+
+        std::string_view back() const {
+            return (*this)[size() - 1];
+        }
+
+        // Views of lines begin .. end, for APIs that take an array
+        std::vector<std::string_view> views(size_t begin, size_t end) const {
+            std::vector<std::string_view> res;
+            res.reserve(end - begin);
+            for (size_t i = begin; i < end; i++) {
+                res.push_back((*this)[i]);
+            }
+            return res;
+        }
+
+        std::vector<std::string_view> views() const {
+            return views(0, size());
+        }
+};
+
+#endif // CORPUS_HPP
\ No newline at end of file
@@ -0,0 +1,162 @@
+#ifndef CRYPTRN_HPP
+#define CRYPTRN_HPP
+
+#include <crypt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include "base64.h"
+
+// Reentrant libxcrypt backend shared by Scrypt and Yescrypt
+// Each thread owns one crypt_data scratch area that crypt_ra allocates on first use and reuses
+// afterwards; the memory-hard arrays themselves are still mapped per call inside libxcrypt
+class CryptScratch {
+    private:
+        void *data = NULL;
+        int size = 0;
+
+    public:
+        ~CryptScratch() {
+            free(data);
+        }
+
+        // Hash password with a crypt setting string, or with a full hash to re-derive it
+        // The result lives in the scratch area until this thread's next call; NULL on failure
+        const char *tryCrypt(const char *password, const char *setting) {
+            char *res = crypt_ra(password, setting, &data, &size);
+            // Failure is a NULL or a "*"-prefixed string; errno alone is unreliable because
+            // libxcrypt may set it on a hugepage attempt it then recovers from
+            return res == NULL || res[0] == '*' ? NULL : res;
+        }
+
+        const char *crypt(const char *password, const char *setting) {
+            const char *res = tryCrypt(password, setting);
+            assert(res != NULL);
+            return res;
+        }
+};
+
+inline CryptScratch &threadScratch() {
+    static thread_local CryptScratch scratch;
+    return scratch;
+}
+
+inline std::string cryptReentrant(const std::string &password, const char *setting) {
+    return std::string(threadScratch().crypt(password.c_str(), setting));
+}
+
+// Hash a password that is not NUL-terminated; the result lives in this thread's scratch area, NULL on failure
+// The password is NUL-terminated on the stack since crypt_ra needs a C string
+inline const char *cryptView(std::string_view password, const char *setting) {
+    char phrase[CRYPT_MAX_PASSPHRASE_SIZE];
+    if (password.size() >= sizeof(phrase)) {
+        return NULL;
+    }
+    memcpy(phrase, password.data(), password.size());
+    phrase[password.size()] = 0;
+    return threadScratch().tryCrypt(phrase, setting);
+}
+
+// Hash into a caller-owned record of size bytes, NUL-padded, without touching the heap
+inline void cryptRecord(std::string_view password, const char *setting, char *out, size_t size) {
+    const char *res = cryptView(password, setting);
+    assert(res != NULL);
+    size_t len = strlen(res);
+    assert(len <= size);
+    memcpy(out, res, len);
+    memset(out + len, 0, size - len);
+}
+
+// Encode salt bytes for a crypt setting: base64_encode's grouping and alphabet without the padding,
+// written to out (4 chars per 3 bytes, rounded up) with a terminating NUL
+inline void cryptEncodeSalt(const unsigned char *salt, size_t len, char *out) {
+    for (; len >= 3; len -= 3, salt += 3) {
+        *out++ = base64_table[salt[0] >> 2];
+        *out++ = base64_table[((salt[0] & 0x03) << 4) | (salt[1] >> 4)];
+        *out++ = base64_table[((salt[1] & 0x0f) << 2) | (salt[2] >> 6)];
+        *out++ = base64_table[salt[2] & 0x3f];
+    }
+    if (len == 1) {
+        *out++ = base64_table[salt[0] >> 2];
+        *out++ = base64_table[(salt[0] & 0x03) << 4];
+    } else if (len == 2) {
+        *out++ = base64_table[salt[0] >> 2];
+        *out++ = base64_table[((salt[0] & 0x03) << 4) | (salt[1] >> 4)];
+        *out++ = base64_table[(salt[1] & 0x0f) << 2];
+    }
+    *out = 0;
+}
+
+// libxcrypt's own encoding for scrypt/yescrypt hashes and yescrypt salts: the same alphabet, but each
+// 3-byte group is read little-endian and written least significant 6 bits first
+// Writes 4 chars per 3 bytes, rounded up, and a terminating NUL; returns the end of the chars
+inline char *cryptEncode64(const unsigned char *src, size_t len, char *out) {
+    for (size_t i = 0; i < len; ) {
+        uint32_t value = 0, bits = 0;
+        do {
+            value |= (uint32_t) src[i++] << bits;
+            bits += 8;
+        } while (bits < 24 && i < len);
+        for (uint32_t done = 0; done < bits; done += 6) {
+            *out++ = base64_table[value & 0x3f];
+            value >>= 6;
+        }
+    }
+    *out = 0;
+    return out;
+}
+
+// Inverse of cryptEncode64 into at most cap bytes; false on a character outside the alphabet,
+// a dangling single char or bits left over past the last byte
+inline bool cryptDecode64(std::string_view in, unsigned char *out, size_t cap, size_t &len) {
+    len = 0;
+    for (size_t i = 0; i < in.size(); i += 4) {
+        size_t chars = std::min((size_t) 4, in.size() - i);
+        if (chars == 1) {
+            return false;
+        }
+        uint32_t value = 0;
+        for (size_t j = 0; j < chars; j++) {
+            const void *at = memchr(base64_table, in[i + j], 64);
+            if (at == NULL || in[i + j] == 0) {
+                return false;
+            }
+            value |= (uint32_t) ((const unsigned char *) at - base64_table) << (6 * j);
+        }
+        size_t bytes = chars * 6 / 8;
+        if (len + bytes > cap || (value >> (8 * bytes)) != 0) {
+            return false;
+        }
+        for (size_t j = 0; j < bytes; j++) {
+            out[len++] = (unsigned char) (value >> (8 * j));
+        }
+    }
+    return true;
+}
+
+// A 30-bit scrypt parameter as the 5 chars of a $7$ setting, least significant first
+inline char *cryptEncodeUint30(uint32_t value, char *out) {
+    for (int i = 0; i < 5; i++, value >>= 6) {
+        *out++ = base64_table[value & 0x3f];
+    }
+    return out;
+}
+
+// Inverse of cryptEncodeUint30 on the 5 chars at in; false on a character outside the alphabet
+inline bool cryptDecodeUint30(const char *in, uint32_t &value) {
+    value = 0;
+    for (int i = 0; i < 5; i++) {
+        const void *at = memchr(base64_table, in[i], 64);
+        if (at == NULL || in[i] == 0) {
+            return false;
+        }
+        value |= (uint32_t) ((const unsigned char *) at - base64_table) << (6 * i);
+    }
+    return true;
+}
+
+#endif // CRYPTRN_HPP
@@ -0,0 +1,194 @@
+#include "hash_one.hpp"
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <charconv>
+
+// 256-bit word for the bit-parallel edit distance kernel, least significant 64 bits first
+struct Bits256 {
+    uint64_t w[4];
+
+    Bits256 operator&(const Bits256 &o) const { return {{w[0] & o.w[0], w[1] & o.w[1], w[2] & o.w[2], w[3] & o.w[3]}}; }
+    Bits256 operator|(const Bits256 &o) const { return {{w[0] | o.w[0], w[1] | o.w[1], w[2] | o.w[2], w[3] | o.w[3]}}; }
+    Bits256 operator^(const Bits256 &o) const { return {{w[0] ^ o.w[0], w[1] ^ o.w[1], w[2] ^ o.w[2], w[3] ^ o.w[3]}}; }
+    Bits256 operator~() const { return {{~w[0], ~w[1], ~w[2], ~w[3]}}; }
+
+    Bits256 operator+(const Bits256 &o) const {
+        Bits256 res;
+        uint64_t carry = 0;
+        for (int i = 0; i < 4; i++) {
+            uint64_t sum = w[i] + o.w[i];
+            res.w[i] = sum + carry;
+            carry = (sum < w[i]) | (res.w[i] < sum);
+        }
+        return res;
+    }
+
+    Bits256 shl1() const {
+        return {{w[0] << 1, (w[1] << 1) | (w[0] >> 63), (w[2] << 1) | (w[1] >> 63), (w[3] << 1) | (w[2] >> 63)}};
+    }
+
+    bool bit(int i) const {
+        return (w[i >> 6] >> (i & 63)) & 1;
+    }
+};
+
+// Pack 32 bytes so that bitstring position i (MSB first within each byte) is bit i of the word
+Bits256 packBits(const unsigned char *bytes) {
+    Bits256 res = {{0, 0, 0, 0}};
+    for (int i = 0; i < 256; i++) {
+        if ((bytes[i >> 3] >> (7 - (i & 7))) & 1) {
+            res.w[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+    return res;
+}
+
+// Damerau-Levenshtein (optimal string alignment) distance between two 256-bit strings
+// Hyyrö's bit-vector algorithm with the whole pattern in one 256-bit word, one step per text bit;
+// matches the O(n^2) dynamic program in py/dl_distance.py
+int dlDistance(const Bits256 &s1, const Bits256 &s2) {
+    const Bits256 zero = {{0, 0, 0, 0}};
+    const Bits256 pm[2] = {~s1, s1};  // Positions of '0' and '1' in s1
+    Bits256 vp = ~zero, vn = zero, d0 = zero, pmOld = zero;
+    int dist = 256;
+    for (int j = 0; j < 256; j++) {
+        const Bits256 &pmj = pm[s2.bit(j)];
+        Bits256 tr = ((~d0 & pmj).shl1()) & pmOld;
+        d0 = ((((pmj & vp) + vp) ^ vp) | pmj | vn) | tr;
+        Bits256 hp = vn | ~(d0 | vp);
+        Bits256 hn = d0 & vp;
+        dist += hp.bit(255);
+        dist -= hn.bit(255);
+        // Row 0 of the table grows by one per text bit, so a 1 shifts into the bottom of hp
+        hp = hp.shl1();
+        hp.w[0] |= 1;
+        hn = hn.shl1();
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        pmOld = pmj;
+    }
+    return dist;
+}
+
+// MT19937 seeded the way Python's random.seed(int) does, so the base bitstring matches py/dl_distance.py
+class PyRandom {
+    private:
+        uint32_t mt[624];
+        int idx = 624;
+
+        uint32_t next() {
+            if (idx >= 624) {
+                for (int i = 0; i < 624; i++) {
+                    uint32_t y = (mt[i] & 0x80000000) | (mt[(i + 1) % 624] & 0x7fffffff);
+                    mt[i] = mt[(i + 397) % 624] ^ (y >> 1) ^ ((y & 1) ? 0x9908b0df : 0);
+                }
+                idx = 0;
+            }
+            uint32_t y = mt[idx++];
+            y ^= y >> 11;
+            y ^= (y << 7) & 0x9d2c5680;
+            y ^= (y << 15) & 0xefc60000;
+            y ^= y >> 18;
+            return y;
+        }
+
+    public:
+        // init_by_array with a single 32-bit key word
+        PyRandom(uint32_t seed) {
+            mt[0] = 19650218;
+            for (int i = 1; i < 624; i++) {
+                mt[i] = 1812433253 * (mt[i - 1] ^ (mt[i - 1] >> 30)) + i;
+            }
+            int i = 1;
+            for (int k = 624; k; k--) {
+                mt[i] = (mt[i] ^ ((mt[i - 1] ^ (mt[i - 1] >> 30)) * 1664525)) + seed;
+                if (++i >= 624) { mt[0] = mt[623]; i = 1; }
+            }
+            for (int k = 623; k; k--) {
+                mt[i] = (mt[i] ^ ((mt[i - 1] ^ (mt[i - 1] >> 30)) * 1566083941)) - i;
+                if (++i >= 624) { mt[0] = mt[623]; i = 1; }
+            }
+            mt[0] = 0x80000000;
+        }
+
+        // random.random()
+        double random() {
+            uint32_t a = next() >> 5, b = next() >> 6;
+            return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+        }
+
+        // ''.join(random.choices('01', k=len))
+        std::string bitstring(int len) {
+            std::string res;
+            for (int i = 0; i < len; i++) {
+                res.push_back(random() < 0.5 ? '0' : '1');
+            }
+            return res;
+        }
+};
+
+// Native replacement for py/dl_distance.py
+// Trial t flips bit t % 256 of a base bitstring; each further 256 trials draw a new base
+// from the same generator, so the first 256 trials are the ones the Python script runs
+int main(int argc, char **argv) {
+    if (argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " [trials] [threads]" << std::endl;
+        return 1;
+    }
+    int trials = argc > 1 ? atoi(argv[1]) : 256;
+    unsigned int max_threads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+    if (trials <= 0 || max_threads == 0) {
+        std::cerr << "trials and threads must be positive" << std::endl;
+        return 1;
+    }
+
+    PyRandom rng(1337);
+    std::vector<std::string> bases;
+    for (int i = 0; i < trials; i += 256) {
+        bases.push_back(rng.bitstring(256));
+    }
+
+    std::cout << "D-L distance" << std::endl;
+    std::cout << "Alg,D-L Ratio" << std::endl;
+    for (std::string algorithm : {"argon2", "sha256", "pbkdf2-600k", "pbkdf2-1m", "yescrypt", "scrypt-mem", "scrypt-bal", "scrypt-cpu", "plaintext"}) {
+        HashBenchmark *alg = algorithm == "plaintext" ? NULL : makeAlgorithm(algorithm);
+        unsigned int threads = alg == NULL || alg->reentrant() ? max_threads : 1;
+        std::atomic<int> next(0);
+        std::atomic<long long> total_distance(0);
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back([&]() {
+                for (int t = next++; t < trials; t = next++) {
+                    if (t % 32 == 0) {
+                        std::cerr << "\r" << algorithm << ": " << t << "/" << trials << "\n";
+                    }
+                    // Flip ith bit of the base bitstring
+                    std::string this_bitstring = bases[t / 256];
+                    this_bitstring[t % 256] ^= 1;
+                    std::string plaintext = bitstringToString(this_bitstring);
+                    std::string hash = digestHex(algorithm, alg, plaintext);
+                    assert(hash.length() == 64);
+                    unsigned char digest[32];
+                    for (int j = 0; j < 32; j++) {
+                        digest[j] = (unsigned char) strtol(hash.substr(2 * j, 2).c_str(), NULL, 16);
+                    }
+                    total_distance += dlDistance(packBits((unsigned char *) plaintext.data()), packBits(digest));
+                }
+            });
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+        delete alg;
+        // Shortest round-trip form, as Python prints floats
+        char ratio[32];
+        char *end = std::to_chars(ratio, ratio + sizeof(ratio) - 3, (double) total_distance / trials / 256).ptr;
+        if (std::string(ratio, end).find_first_of(".e") == std::string::npos) {
+            end = std::copy_n(".0", 2, end);
+        }
+        *end = 0;
+        std::cout << algorithm << "," << ratio << std::endl;
+    }
+    return 0;
+}
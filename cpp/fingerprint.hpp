@@ -0,0 +1,263 @@
+#ifndef FINGERPRINT_HPP
+#define FINGERPRINT_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <utility>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <cpuid.h>
+#include <crypt.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <sys/sysinfo.h>
+#include <openssl/crypto.h>
+#include "pagepolicy.hpp"
+#include "sha256_mb.hpp"
+#include "argon2_core.hpp"
+#include "scrypt_core.hpp"
+
+// Everything about the host that moves the numbers, read natively once per run
+// Fields the host does not expose (no cpufreq in a VM, ...) read "n/a"
+class HostFingerprint {
+    private:
+        std::vector<std::pair<std::string, std::string>> fields;
+        std::string summaryLine;
+
+        static std::string readLine(const std::string &path) {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+
+        static std::string orNa(const std::string &value) {
+            return value.empty() ? "n/a" : value;
+        }
+
+        static std::string cpuidBrand() {
+            unsigned int regs[12];
+            if (__get_cpuid_max(0x80000000, NULL) < 0x80000004) {
+                return "";
+            }
+            for (unsigned int i = 0; i < 3; i++) {
+                __get_cpuid(0x80000002 + i, &regs[4 * i], &regs[4 * i + 1], &regs[4 * i + 2], &regs[4 * i + 3]);
+            }
+            std::string brand((const char *) regs, sizeof(regs));
+            brand = brand.c_str();
+            size_t start = brand.find_first_not_of(' ');
+            return start == std::string::npos ? "" : brand.substr(start);
+        }
+
+        // Vendor and family/model/stepping from leaf 0 and 1, e.g. "GenuineIntel 6/106/6"
+        static std::string cpuidSignature() {
+            unsigned int eax, ebx, ecx, edx;
+            if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+                return "";
+            }
+            char vendor[13];
+            memcpy(vendor, &ebx, 4);
+            memcpy(vendor + 4, &edx, 4);
+            memcpy(vendor + 8, &ecx, 4);
+            vendor[12] = 0;
+            __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+            unsigned int family = (eax >> 8) & 0xf, model = (eax >> 4) & 0xf;
+            if (family == 0xf) {
+                family += (eax >> 20) & 0xff;
+            }
+            if (family == 0x6 || family >= 0xf) {
+                model |= ((eax >> 16) & 0xf) << 4;
+            }
+            return std::string(vendor) + " " + std::to_string(family) + "/" + std::to_string(model) + "/" + std::to_string(eax & 0xf);
+        }
+
+        // __builtin_cpu_supports only takes literals
+        static std::string isaFlags() {
+            std::string flags;
+            const std::pair<const char *, bool> features[] = {
+                {"sse2", __builtin_cpu_supports("sse2")},
+                {"ssse3", __builtin_cpu_supports("ssse3")},
+                {"avx", __builtin_cpu_supports("avx")},
+                {"avx2", __builtin_cpu_supports("avx2")},
+                {"avx512f", __builtin_cpu_supports("avx512f")},
+                {"sha", __builtin_cpu_supports("sha")},
+                {"aes", __builtin_cpu_supports("aes")},
+                {"bmi2", __builtin_cpu_supports("bmi2")},
+            };
+            for (const auto &feature : features) {
+                if (feature.second) {
+                    flags += (flags.empty() ? "" : " ") + std::string(feature.first);
+                }
+            }
+            return flags;
+        }
+
+        // Cache levels as cpu0 sees them, e.g. "L1d 48K L1i 32K L2 2048K L3 105M"
+        static std::string caches() {
+            std::string res;
+            for (int i = 0; ; i++) {
+                std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(i);
+                std::string level = readLine(dir + "/level");
+                if (level.empty()) {
+                    break;
+                }
+                std::string type = readLine(dir + "/type");
+                std::string name = "L" + level + (type == "Data" ? "d" : type == "Instruction" ? "i" : "");
+                res += (res.empty() ? "" : " ") + name + " " + readLine(dir + "/size");
+            }
+            return res;
+        }
+
+        // Sockets, physical cores and hardware threads among the online CPUs
+        static std::string topology() {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            std::set<std::string> sockets, cores;
+            for (long cpu = 0, seen = 0; seen < cpus && cpu < 4096; cpu++) {
+                std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology";
+                std::string package = readLine(dir + "/physical_package_id");
+                if (package.empty()) {
+                    continue;
+                }
+                seen++;
+                sockets.insert(package);
+                cores.insert(package + ":" + readLine(dir + "/core_id"));
+            }
+            if (cores.empty()) {
+                return std::to_string(cpus) + " threads";
+            }
+            return std::to_string(sockets.size()) + " sockets " + std::to_string(cores.size()) + " cores " + std::to_string(cpus) + " threads";
+        }
+
+        // cpufreq when the host exposes it, else what /proc/cpuinfo last saw
+        static std::string frequency() {
+            std::string khz = readLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq");
+            if (!khz.empty()) {
+                return std::to_string(atol(khz.c_str()) / 1000) + " MHz";
+            }
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            while (std::getline(cpuinfo, line)) {
+                if (line.compare(0, 7, "cpu MHz") == 0) {
+                    return std::to_string(atol(line.substr(line.find(':') + 1).c_str())) + " MHz";
+                }
+            }
+            return "";
+        }
+
+        static std::string osRelease() {
+            std::ifstream file("/etc/os-release");
+            std::string line;
+            while (std::getline(file, line)) {
+                if (line.compare(0, 12, "PRETTY_NAME=") == 0) {
+                    std::string name = line.substr(12);
+                    if (name.size() >= 2 && name.front() == '"') {
+                        name = name.substr(1, name.size() - 2);
+                    }
+                    return name;
+                }
+            }
+            return "";
+        }
+
+        // File the dynamic linker actually mapped for a library, symlinks resolved
+        static std::string loadedLibrary(const char *prefix) {
+            std::pair<const char *, std::string> search(prefix, "");
+            dl_iterate_phdr([](struct dl_phdr_info *info, size_t, void *data) {
+                auto *search = (std::pair<const char *, std::string> *) data;
+                const char *base = strrchr(info->dlpi_name, '/');
+                base = base != NULL ? base + 1 : info->dlpi_name;
+                if (strncmp(base, search->first, strlen(search->first)) != 0) {
+                    return 0;
+                }
+                char resolved[PATH_MAX];
+                const char *path = realpath(info->dlpi_name, resolved) != NULL ? resolved : info->dlpi_name;
+                const char *file = strrchr(path, '/');
+                search->second = file != NULL ? file + 1 : path;
+                return 1;
+            }, &search);
+            return search.second;
+        }
+
+        HostFingerprint() {
+            struct utsname uts;
+            uname(&uts);
+            struct sysinfo info;
+            sysinfo(&info);
+            long long ramGb = std::llround((double) info.totalram * info.mem_unit / 1e9);
+            HostPageConfig pages = HostPageConfig::read();
+            std::string model = orNa(cpuidBrand());
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+            fields = {
+                {"CPU", model},
+                {"CPUID", orNa(cpuidSignature())},
+                {"ISA", orNa(isaFlags())},
+                {"Caches", orNa(caches())},
+                {"Topology", topology()},
+                {"Governor", orNa(readLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"))},
+                {"Frequency", orNa(frequency())},
+                {"RAM", std::to_string(ramGb) + " GB"},
+                {"THP", orNa(pages.thpMode)},
+                {"Hugepages", "2M=" + std::to_string(pages.pages2M) + " 1G=" + std::to_string(pages.pages1G)},
+                {"OS", orNa(osRelease())},
+                {"Kernel", std::string(uts.sysname) + " " + uts.release + " " + uts.machine},
+                {"OpenSSL", OpenSSL_version(OPENSSL_VERSION)},
+                {"libargon2", orNa(loadedLibrary("libargon2"))},
+#ifdef XCRYPT_VERSION_STR
+                {"libxcrypt", std::string(XCRYPT_VERSION_STR) + " " + orNa(loadedLibrary("libcrypt.so"))},
+#else
+                {"libxcrypt", orNa(loadedLibrary("libcrypt.so"))},
+#endif
+                {"SHA-256 kernel", sha256_mb::isaName(sha256_mb::bestIsa())},
+                {"Argon2 kernel", argon2_core::isaName(argon2_core::defaultIsa())},
+                {"Scrypt kernel", scrypt_core::isaName(scrypt_core::defaultIsa())},
+            };
+
+            // Leads with the four fields get_hw_string.py reported, CPU, OS, Python version and RAM,
+            // except that the third is now the kernel string; there is no Python version to report.
+            // Old csv headers line up in count and position, but not in that field's content
+            std::ostringstream line;
+            line << cpus << "x " << model << "," << get("OS") << "," << get("Kernel") << "," << ramGb << " GB RAM";
+            for (const char *key : {"CPUID", "Caches", "Topology", "Governor", "Frequency", "THP", "Hugepages", "OpenSSL", "libargon2", "libxcrypt", "Argon2 kernel", "Scrypt kernel"}) {
+                line << "," << key << " " << get(key);
+            }
+            summaryLine = line.str();
+        }
+
+    public:
+        static const HostFingerprint &instance() {
+            static HostFingerprint fingerprint;
+            return fingerprint;
+        }
+
+        std::string get(const std::string &key) const {
+            for (const auto &field : fields) {
+                if (field.first == key) {
+                    return field.second;
+                }
+            }
+            return "";
+        }
+
+        // One line for the header of every results csv
+        const std::string &summary() const {
+            return summaryLine;
+        }
+
+        // Every field, one Key,Value row each
+        void writeCsv(std::ostream &f) const {
+            f << "Key,Value" << std::endl;
+            for (const auto &field : fields) {
+                f << field.first << "," << field.second << std::endl;
+            }
+        }
+};
+
+#endif // FINGERPRINT_HPP
\ No newline at end of file
@@ -3,19 +3,33 @@
 
 #include <chrono>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstring>
 #include <fstream>
 #include <cassert>
+#include <atomic>
+#include <thread>
 #include <sys/resource.h>
+#include "corpus.hpp"
+#include "histogram.hpp"
+#include "pagepolicy.hpp"
+#include "phc.hpp"
+#include "saltprovider.hpp"
+#include "stats.hpp"
+
+// Per-call latencies of _hash and of _checkHash on the hash it just made
+struct LatencyProfile {
+    LatencyHistogram hash;
+    LatencyHistogram check;
+};
 
 // Abstract class for benchmarking
 class HashBenchmark {
     protected:
-        // Generate a cryptographically-secure seed
+        // Generate a cryptographically-secure seed, or a reproducible one in SALT_SEEDED mode
         void generateSeed(size_t size, char *seed) {
-            std::ifstream urandom("/dev/urandom", std::ios::in | std::ios::binary);
-            urandom.read(seed, size);
-            urandom.close();
+            SaltProvider::fill(seed, size);
         }
 
         // Hexify a byte string into an existing std::string
@@ -28,9 +42,55 @@ class HashBenchmark {
             }
         }
 
+        // Hexify a byte string into a caller-owned buffer of size * 2 chars
+        void hexify(const unsigned char *bytes, size_t size, char *hex) {
+            static const char *hexmap = "0123456789abcdef";
+            for (size_t i = 0; i < size; i++) {
+                hex[2 * i] = hexmap[bytes[i] >> 4];
+                hex[2 * i + 1] = hexmap[bytes[i] & 0xf];
+            }
+        }
+
+        // Decode size bytes from 2 * size lowercase hex chars; false on any other character
+        bool unhexify(const char *hex, size_t size, unsigned char *bytes) {
+            auto nibble = [](char c) {
+                return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            };
+            for (size_t i = 0; i < size; i++) {
+                int hi = nibble(hex[2 * i]), lo = nibble(hex[2 * i + 1]);
+                if (hi < 0 || lo < 0) {
+                    return false;
+                }
+                bytes[i] = (unsigned char) (hi << 4 | lo);
+            }
+            return true;
+        }
+
     public:
         std::string name;
+        // Hardware counters of the last timed phase, when PerfGroup::enabled
+        PerfCounts counters;
+        // Largest parameters phcDerive, and _checkHash where it reads foreign settings, will run
+        PhcCostPolicy costPolicy;
         HashBenchmark(std::string name) : name(name) {}
+        virtual ~HashBenchmark() {}
+
+        // Whether _hash and _checkHash may be called from several threads at once
+        virtual bool reentrant() {
+            return true;
+        }
+
+        // Bytes of working memory one hash needs, 0 for algorithms that are not memory-hard
+        virtual size_t memoryCost() {
+            return 0;
+        }
+
+        // Back this algorithm's working memory as the policy asks
+        // Returns false when that memory is allocated inside a library, where only the host-wide
+        // settings from configureHost apply
+        virtual bool setPagePolicy(PagePolicy policy) {
+            return false;
+        }
 
         // Hash a password and return the string representation
         virtual std::string _hash(const std::string &password) = 0;
@@ -38,32 +98,190 @@ class HashBenchmark {
         // Check if a hash matches a password
         virtual bool _checkHash(const std::string &hash, const std::string &password) = 0;
 
+        // Hash a password into a PHC string in out, which needs PHC_MAX_LENGTH bytes; returns its length
+        // Like hashBatch this never touches the heap
+        virtual size_t phcHash(std::string_view password, char *out) = 0;
+
+        // Derive the digest a decoded PHC record's parameters and salt give a password, rec.hashLen bytes
+        // into out; false when the record is not this algorithm's or its parameters are unusable
+        virtual bool phcDerive(const PhcRecord &rec, std::string_view password, uint8_t *out) = 0;
+
+        // Check a password against a PHC string, comparing raw digests in constant time
+        // Parameters come from the string, so hashes made under other settings still verify
+        bool phcVerify(std::string_view phc, std::string_view password) {
+            PhcRecord rec;
+            uint8_t digest[PhcRecord::maxHash];
+            return phc::decode(phc, rec) && phcDerive(rec, password, digest) && phc::digestEqual(digest, rec.hash, rec.hashLen);
+        }
+
+        // Width in bytes of one record written by hashBatch
+        virtual size_t recordSize() = 0;
+
+        // Hash count passwords into out, one recordSize() record per password holding the string
+        // _hash would return, NUL-padded; nothing is allocated, out is the only memory written
+        virtual void hashBatch(const std::string_view *passwords, size_t count, char *out) = 0;
+
+        // The string held by record i of a hashBatch output buffer
+        std::string_view batchRecord(const char *out, size_t i) {
+            const char *record = out + i * recordSize();
+            return std::string_view(record, strnlen(record, recordSize()));
+        }
+
         // Time taken to compute hashes for every password in the file
-        void _computeTime(std::vector<std::string> &passwords) {
-            for (const std::string &password : passwords) {
+        // One string is reused for every password, so short ones never reach the heap
+        void _computeTime(const Corpus &passwords) {
+            std::string password;
+            for (size_t i = 0; i < passwords.size(); i++) {
+                password.assign(passwords[i]);
                 _hash(password);
             }
         }
 
         double computeTime(std::string passwordFile) {
-            std::vector<std::string> passwords;
-            std::ifstream file(passwordFile);
-            std::string password;
-            while (std::getline(file, password)) {
-                passwords.push_back(password);
-            }
-            file.close();
+            const Corpus &passwords = Corpus::load(passwordFile);
 
+            PerfGroup perf;
+            perf.start();
             auto start = std::chrono::high_resolution_clock::now();
             _computeTime(passwords);
             auto end = std::chrono::high_resolution_clock::now();
+            counters = perf.stop(passwords.size());
+            return std::chrono::duration<double>(end - start).count();
+        }
+
+        // computeTime repeated under the harness, with warmup and CPU-time accounting
+        Measurement computeTimeStats(std::string passwordFile, const HarnessConfig &config = HarnessConfig()) {
+            const Corpus &passwords = Corpus::load(passwordFile);
+            return measure([&]() { _computeTime(passwords); }, passwords.size(), config);
+        }
+
+        // Time taken to compute hashes for every password in the file with one hashBatch call
+        // The output buffer is sized up front and every record is checked afterwards, outside the timed region
+        double computeTimeBatch(std::string passwordFile) {
+            const Corpus &passwords = Corpus::load(passwordFile);
+            std::vector<std::string_view> views = passwords.views();
+            std::vector<char> out(passwords.size() * recordSize());
+
+            PerfGroup perf;
+            perf.start();
+            auto start = std::chrono::high_resolution_clock::now();
+            hashBatch(views.data(), views.size(), out.data());
+            auto end = std::chrono::high_resolution_clock::now();
+            counters = perf.stop(passwords.size());
+
+            for (size_t i = 0; i < passwords.size(); i++) {
+                assert(_checkHash(std::string(batchRecord(out.data(), i)), std::string(passwords[i])));
+            }
+            return std::chrono::duration<double>(end - start).count();
+        }
+
+        // Time taken to compute hashes for every password in the file on a pool of worker threads
+        // Workers claim passwords from a shared counter, so a slow hash never stalls a whole partition
+        void _computeTimeParallel(const Corpus &passwords, unsigned int threads) {
+            std::atomic<size_t> next(0);
+            std::vector<std::thread> workers;
+            for (unsigned int i = 0; i < threads; i++) {
+                workers.emplace_back([&]() {
+                    std::string password;
+                    for (size_t j = next++; j < passwords.size(); j = next++) {
+                        password.assign(passwords[j]);
+                        _hash(password);
+                    }
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+
+        double computeTimeParallel(std::string passwordFile, unsigned int threads) {
+            assert(threads == 1 || reentrant());
+            const Corpus &passwords = Corpus::load(passwordFile);
+
+            PerfGroup perf;
+            perf.start();
+            auto start = std::chrono::high_resolution_clock::now();
+            _computeTimeParallel(passwords, threads);
+            auto end = std::chrono::high_resolution_clock::now();
+            counters = perf.stop(passwords.size());
+            return std::chrono::duration<double>(end - start).count();
+        }
+
+        // computeTimeParallel repeated under the harness; thread CPU is the coordinating thread's only
+        Measurement computeTimeParallelStats(std::string passwordFile, unsigned int threads, const HarnessConfig &config = HarnessConfig()) {
+            assert(threads == 1 || reentrant());
+            const Corpus &passwords = Corpus::load(passwordFile);
+            return measure([&]() { _computeTimeParallel(passwords, threads); }, passwords.size(), config);
+        }
+
+        // Hash then verify every password in the file on a pool of worker threads, timing each call
+        // Each worker records into its own histograms, which are merged after the join
+        LatencyProfile latencyProfile(std::string passwordFile, unsigned int threads) {
+            assert(threads == 1 || reentrant());
+            const Corpus &passwords = Corpus::load(passwordFile);
+            std::vector<LatencyProfile> recorders(threads);
+            std::atomic<size_t> next(0);
+            std::vector<std::thread> workers;
+            for (unsigned int i = 0; i < threads; i++) {
+                workers.emplace_back([&, i]() {
+                    LatencyProfile &recorder = recorders[i];
+                    std::string password;
+                    for (size_t j = next++; j < passwords.size(); j = next++) {
+                        password.assign(passwords[j]);
+                        auto start = std::chrono::steady_clock::now();
+                        std::string hash = _hash(password);
+                        auto hashed = std::chrono::steady_clock::now();
+                        bool match = _checkHash(hash, password);
+                        auto checked = std::chrono::steady_clock::now();
+                        assert(match);
+                        recorder.hash.record(std::chrono::duration_cast<std::chrono::nanoseconds>(hashed - start).count());
+                        recorder.check.record(std::chrono::duration_cast<std::chrono::nanoseconds>(checked - hashed).count());
+                    }
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            LatencyProfile profile;
+            for (LatencyProfile &recorder : recorders) {
+                profile.hash.merge(recorder.hash);
+                profile.check.merge(recorder.check);
+            }
+            return profile;
+        }
+
+        // Time taken to verify every password in the file against its own stored hash
+        // Hashes are made up front, outside the timed region; with phc set they are PHC strings
+        // checked by phcVerify, otherwise _hash strings checked by _checkHash
+        double verifyTime(std::string passwordFile, bool phc) {
+            const Corpus &passwords = Corpus::load(passwordFile);
+            std::vector<std::string> hashes(passwords.size());
+            std::vector<std::string> plain(passwords.size());
+            char out[PHC_MAX_LENGTH];
+            for (size_t i = 0; i < passwords.size(); i++) {
+                plain[i].assign(passwords[i]);
+                hashes[i] = phc ? std::string(out, phcHash(passwords[i], out)) : _hash(plain[i]);
+            }
+
+            PerfGroup perf;
+            perf.start();
+            bool ok = true;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < passwords.size(); i++) {
+                ok &= phc ? phcVerify(hashes[i], passwords[i]) : _checkHash(hashes[i], plain[i]);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            counters = perf.stop(passwords.size());
+            assert(ok);
             return std::chrono::duration<double>(end - start).count();
         }
 
         // Time taken to check all the passwords in the file against the hash of the last one
-        void _bruteForceTime(std::vector<std::string> &passwords) {
-            std::string target = _hash(passwords.back());
-            for (const std::string &password : passwords) {
+        void _bruteForceTime(const Corpus &passwords) {
+            std::string target = _hash(std::string(passwords.back()));
+            std::string password;
+            for (size_t i = 0; i < passwords.size(); i++) {
+                password.assign(passwords[i]);
                 if (_checkHash(target, password)) {
                     return;
                 }
@@ -72,42 +290,44 @@ class HashBenchmark {
         }
 
         double bruteForceTime(std::string passwordFile) {
-            std::vector<std::string> passwords;
-            std::ifstream file(passwordFile);
-            std::string password;
-            while (std::getline(file, password)) {
-                passwords.push_back(password);
-            }
-            file.close();
+            const Corpus &passwords = Corpus::load(passwordFile);
 
+            PerfGroup perf;
+            perf.start();
             auto start = std::chrono::high_resolution_clock::now();
             _bruteForceTime(passwords);
             auto end = std::chrono::high_resolution_clock::now();
+            counters = perf.stop(passwords.size());
             return std::chrono::duration<double>(end - start).count();
         }
 
+        // bruteForceTime repeated under the harness
+        Measurement bruteForceTimeStats(std::string passwordFile, const HarnessConfig &config = HarnessConfig()) {
+            const Corpus &passwords = Corpus::load(passwordFile);
+            return measure([&]() { _bruteForceTime(passwords); }, passwords.size(), config);
+        }
+
         // Get stack+heap memory usage of hashing function
         // We can do library memory usage later
-        void _memoryFootprintTarget(std::vector<std::string> &passwords) {
-            for (const std::string &password : passwords) {
+        void _memoryFootprintTarget(const Corpus &passwords) {
+            std::string password;
+            for (size_t i = 0; i < passwords.size(); i++) {
+                password.assign(passwords[i]);
                 _hash(password);
             }
         }
 
         unsigned long long memoryFootprint(std::string passwordFile) {
-            std::vector<std::string> passwords;
-            std::ifstream file(passwordFile);
-            std::string password;
-            while (std::getline(file, password)) {
-                passwords.push_back(password);
-            }
-            file.close();
+            const Corpus &passwords = Corpus::load(passwordFile);
 
             struct rusage initialMemUsage;
             struct rusage finalMemUsage;
+            PerfGroup perf;
+            perf.start();
             assert(!getrusage(RUSAGE_SELF, &initialMemUsage));
             _memoryFootprintTarget(passwords);
             assert(!getrusage(RUSAGE_SELF, &finalMemUsage));
+            counters = perf.stop(passwords.size());
 
             return finalMemUsage.ru_maxrss - initialMemUsage.ru_maxrss;
         }
@@ -1,71 +1,64 @@
-#include "argon2.cpp"
-#include "sha256.cpp"
-#include "pbkdf2.cpp"
-#include "yescrypt.cpp"
-#include "scrypt.cpp"
-#include "plaintext.cpp"
+#include "hash_one.hpp"
 #include <iostream>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
 
-std::string bitstringToString(const std::string &bitstring) {
-    std::string res;
-    for (int i = 0; i < bitstring.length(); i += 8) {
-        char byte = 0;
-        for (int j = 0; j < 8; j++) {
-            byte <<= 1;
-            byte |= bitstring[i + j] - '0';
+// Reads "<algorithm> <plaintext_bitstring>" records, one per line, and prints one hex digest per line
+// Each algorithm is constructed once, reused for every record that names it, and freed on any return
+int hashStream(std::istream &in) {
+    std::unordered_map<std::string, std::unique_ptr<HashBenchmark>> algorithms;
+    std::string algorithm, bitstring;
+    while (in >> algorithm >> bitstring) {
+        HashBenchmark *alg = NULL;
+        if (algorithm != "plaintext") {
+            auto it = algorithms.find(algorithm);
+            if (it == algorithms.end()) {
+                alg = makeAlgorithm(algorithm);
+                if (alg == NULL) {
+                    std::cerr << "Invalid algorithm: " << algorithm << std::endl;
+                    return 1;
+                }
+                algorithms[algorithm].reset(alg);
+            } else {
+                alg = it->second.get();
+            }
         }
-        res.push_back(byte);
+        // Flushed per record so a caller can feed one record and wait for its answer
+        std::cout << digestHex(algorithm, alg, bitstringToString(bitstring)) << std::endl;
     }
-    return res;
-}
-
-std::string hexify(unsigned char *bytes, size_t size) {
-    std::string hex;
-    static const char *hexmap = "0123456789abcdef";
-    for (size_t i = 0; i < size; i++) {
-        hex.push_back(hexmap[bytes[i] >> 4]);
-        hex.push_back(hexmap[bytes[i] & 0xf]);
-    }
-    return hex;
+    return 0;
 }
 
 // Hashes a plaintext bitstring using the specified algorithm and prints the resulting hex string
+// With --batch, reads records from the given file (or stdin) instead, see hashStream
 int main(int argc, char **argv) {
+    if (argc >= 2 && argc <= 3 && std::string(argv[1]) == "--batch") {
+        if (argc == 2) {
+            return hashStream(std::cin);
+        }
+        std::ifstream file(argv[2]);
+        if (!file) {
+            std::cerr << "Cannot open " << argv[2] << std::endl;
+            return 1;
+        }
+        return hashStream(file);
+    }
     if (argc != 3) {
         std::cerr << "Usage: " << argv[0] << " <algorithm> <plaintext_bitstring>" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch [records_file]" << std::endl;
         return 1;
     }
     std::string algorithm = argv[1];
     std::string bitstring = argv[2];
     std::string plaintext = bitstringToString(bitstring);
-    HashBenchmark *alg;
-    if (algorithm == "argon2") alg = new Argon2(algorithm);
-    else if (algorithm == "sha256") alg = new Sha256(algorithm);
-    else if (algorithm == "pbkdf2-600k") alg = new Pbkdf2(algorithm, 600000);
-    else if (algorithm == "pbkdf2-1m") alg = new Pbkdf2(algorithm, 1000000);
-    else if (algorithm == "yescrypt") alg = new Yescrypt(algorithm, 4096);
-    else if (algorithm == "scrypt-mem") alg = new Scrypt(algorithm, 1 << 17, 8, 1);
-    else if (algorithm == "scrypt-bal") alg = new Scrypt(algorithm, 1 << 15, 8, 3);
-    else if (algorithm == "scrypt-cpu") alg = new Scrypt(algorithm, 1 << 13, 8, 10);
-    else if (algorithm == "plaintext") {
-        std::cout << hexify((unsigned char *) plaintext.c_str(), 32) << std::endl;
-        return 0;
-    } else {
-        std::cerr << "Invalid algorithm: " << algorithm << std::endl;
-        return 1;
-    }
-    // Remove salt and other garbage
-    std::string hash = alg->_hash(plaintext);
-    int hash_part_idx = 0;
-    for (int i = 0; i < hash.length(); i++) if (hash[i] == '$') hash_part_idx = i + 1;
-    hash = hash.substr(hash_part_idx);
-
-    // Un-base64 scrypt and yescrypt
-    if (algorithm == "yescrypt" || algorithm.find("scrypt") != std::string::npos) {
-        while (hash.length() % 4 != 0) hash.push_back('=');
-        size_t out_len;
-        unsigned char *s = base64_decode((const unsigned char *) hash.c_str(), hash.size(), &out_len);
-        hash = hexify(s, out_len);
+    HashBenchmark *alg = NULL;
+    if (algorithm != "plaintext") {
+        alg = makeAlgorithm(algorithm);
+        if (alg == NULL) {
+            std::cerr << "Invalid algorithm: " << algorithm << std::endl;
+            return 1;
+        }
     }
-    std::cout << hash << std::endl;
+    std::cout << digestHex(algorithm, alg, plaintext) << std::endl;
 }
@@ -0,0 +1,115 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Log-linear latency histogram in nanoseconds, in the style of HdrHistogram
+// Values below 128 ns get a bucket each; above that every power of two is split into 64 buckets,
+// so any recorded value is within 1/64 (1.6%) of its bucket's bounds. The last bucket starts at
+// 127 * 2^34 ns (36.4 minutes) and also takes every value from 2^41 ns (36.7 minutes) up
+// Recording is a plain increment: one recorder per thread, merged once the threads are joined
+class LatencyHistogram {
+    private:
+        static const int subBits = 6;
+        static const uint64_t subCount = 1 << subBits;  // Buckets per power of two
+        // Values below 2^(maxBits - 1) ns get a bucket of their own power of two
+        static const int maxBits = 42;
+        static const size_t bucketCount = 2 * subCount + (maxBits - subBits - 2) * subCount;
+
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t minValue = UINT64_MAX;
+        uint64_t maxValue = 0;
+        long double sum = 0;
+
+        static size_t indexOf(uint64_t ns) {
+            if (ns < 2 * subCount) {
+                return ns;
+            }
+            int shift = 63 - __builtin_clzll(ns) - subBits;
+            size_t index = 2 * subCount + (shift - 1) * subCount + ((ns >> shift) - subCount);
+            return index < bucketCount ? index : bucketCount - 1;
+        }
+
+    public:
+        LatencyHistogram() : counts(bucketCount, 0) {}
+
+        // Smallest value that falls in a bucket
+        static uint64_t lowerBound(size_t index) {
+            if (index < 2 * subCount) {
+                return index;
+            }
+            int shift = (index - 2 * subCount) / subCount + 1;
+            return (subCount + (index - 2 * subCount) % subCount) << shift;
+        }
+
+        // Largest value that falls in a bucket
+        static uint64_t upperBound(size_t index) {
+            return index + 1 < bucketCount ? lowerBound(index + 1) - 1 : UINT64_MAX;
+        }
+
+        void record(uint64_t ns) {
+            counts[indexOf(ns)]++;
+            total++;
+            sum += ns;
+            minValue = ns < minValue ? ns : minValue;
+            maxValue = ns > maxValue ? ns : maxValue;
+        }
+
+        void merge(const LatencyHistogram &other) {
+            for (size_t i = 0; i < bucketCount; i++) {
+                counts[i] += other.counts[i];
+            }
+            total += other.total;
+            sum += other.sum;
+            minValue = other.minValue < minValue ? other.minValue : minValue;
+            maxValue = other.maxValue > maxValue ? other.maxValue : maxValue;
+        }
+
+        uint64_t count() const {
+            return total;
+        }
+
+        uint64_t min() const {
+            return total ? minValue : 0;
+        }
+
+        uint64_t max() const {
+            return maxValue;
+        }
+
+        double mean() const {
+            return total ? (double) (sum / total) : 0;
+        }
+
+        // Value at quantile q in [0, 1]: the upper bound of the bucket holding that rank, clamped to the
+        // largest value seen, so it never understates a tail
+        uint64_t percentile(double q) const {
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = (uint64_t) std::ceil(q * total);
+            rank = rank < 1 ? 1 : rank > total ? total : rank;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bucketCount; i++) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    uint64_t high = upperBound(i);
+                    return high < maxValue ? high : maxValue;
+                }
+            }
+            return maxValue;
+        }
+
+        size_t buckets() const {
+            return bucketCount;
+        }
+
+        uint64_t bucket(size_t index) const {
+            return counts[index];
+        }
+};
+
+#endif // HISTOGRAM_HPP
\ No newline at end of file
@@ -0,0 +1,219 @@
+#ifndef LOADSIM_HPP
+#define LOADSIM_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <cassert>
+#include "framework.hpp"
+
+// How logins arrive
+// ARRIVAL_POISSON spaces them by exponential gaps; ARRIVAL_BURSTY sends bursts of burstSize logins at
+// once, the bursts themselves Poisson at qps / burstSize, so the mean rate is the same
+enum ArrivalPattern { ARRIVAL_POISSON, ARRIVAL_BURSTY };
+
+inline const char *arrivalPatternName(ArrivalPattern pattern) {
+    switch (pattern) {
+        case ARRIVAL_POISSON: return "poisson";
+        case ARRIVAL_BURSTY: return "bursty";
+    }
+    return "unknown";
+}
+
+struct LoadConfig {
+    double qps = 1;
+    ArrivalPattern pattern = ARRIVAL_POISSON;
+    size_t burstSize = 8;
+    size_t requests = 100;        // Logins offered in one run
+    unsigned int workers = 1;     // Threads verifying logins
+    size_t queueCapacity = 1024;  // Logins waiting beyond this are rejected
+    uint64_t seed = 1;            // Arrival schedules are reproducible
+};
+
+// Latencies of one open-loop run, in nanoseconds
+// Queueing and end-to-end latency count from the scheduled arrival, not from when the generator got to
+// it, so a generator falling behind still shows up as delay instead of hiding it
+struct LoadResult {
+    LatencyHistogram queueing;
+    LatencyHistogram service;
+    LatencyHistogram endToEnd;
+    size_t offered = 0;
+    size_t completed = 0;
+    size_t rejected = 0;   // Arrived to a full queue
+    size_t failed = 0;     // _checkHash said no to a correct password
+    double elapsed = 0;    // From the first scheduled arrival to the last completion
+
+    double achievedQps() const {
+        return completed / elapsed;
+    }
+
+    static const char *csvHeader() {
+        return "Offered,Completed,Rejected,AchievedQps,QueueP50(ns),QueueP99(ns),ServiceP50(ns),ServiceP99(ns),E2EP50(ns),E2EP99(ns),E2EP999(ns),E2EMax(ns)";
+    }
+
+    void writeCsv(std::ostream &f) const {
+        f << offered << "," << completed << "," << rejected << "," << achievedQps() << ","
+          << queueing.percentile(0.5) << "," << queueing.percentile(0.99) << ","
+          << service.percentile(0.5) << "," << service.percentile(0.99) << ","
+          << endToEnd.percentile(0.5) << "," << endToEnd.percentile(0.99) << "," << endToEnd.percentile(0.999) << ","
+          << endToEnd.max();
+    }
+};
+
+// Open-loop login server: a generator thread offers logins on their own schedule to a bounded queue
+// served by a fixed worker pool, each login a _checkHash of a stored hash against its correct password
+class LoadSimulator {
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Login {
+            Clock::time_point arrival;  // Scheduled, not actual
+            size_t account;
+        };
+
+        // Per-worker recorders, merged after the join
+        struct Recorder {
+            LatencyHistogram queueing;
+            LatencyHistogram service;
+            LatencyHistogram endToEnd;
+            size_t failed = 0;
+            Clock::time_point last;
+        };
+
+        HashBenchmark &algorithm;
+        std::vector<std::string> passwords;
+        std::vector<std::string> hashes;
+
+        static uint64_t nanos(Clock::duration d) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        }
+
+        // Arrival offsets from the start of the run
+        static std::vector<Clock::duration> schedule(const LoadConfig &config) {
+            std::mt19937_64 rng(config.seed);
+            size_t burst = config.pattern == ARRIVAL_BURSTY ? config.burstSize : 1;
+            std::exponential_distribution<double> gap(config.qps / burst);
+            std::vector<Clock::duration> arrivals;
+            arrivals.reserve(config.requests);
+            double at = 0;
+            while (arrivals.size() < config.requests) {
+                at += gap(rng);
+                auto offset = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(at));
+                for (size_t i = 0; i < burst && arrivals.size() < config.requests; i++) {
+                    arrivals.push_back(offset);
+                }
+            }
+            return arrivals;
+        }
+
+    public:
+        // Accounts are the first accounts passwords of the file, hashed once up front
+        // Logins are spread over the accounts, so there must be at least one
+        LoadSimulator(HashBenchmark &algorithm, const std::string &passwordFile, size_t accounts) : algorithm(algorithm) {
+            const Corpus &corpus = Corpus::load(passwordFile);
+            accounts = std::min(accounts, corpus.size());
+            assert(accounts > 0);
+            for (size_t i = 0; i < accounts; i++) {
+                passwords.emplace_back(corpus[i]);
+                hashes.push_back(algorithm._hash(passwords.back()));
+            }
+        }
+
+        // Mean closed-loop _checkHash time over every account, in seconds
+        double serviceTime() {
+            auto start = Clock::now();
+            for (size_t i = 0; i < hashes.size(); i++) {
+                assert(algorithm._checkHash(hashes[i], passwords[i]));
+            }
+            return std::chrono::duration<double>(Clock::now() - start).count() / hashes.size();
+        }
+
+        LoadResult run(LoadConfig config) {
+            if (!algorithm.reentrant()) {
+                config.workers = 1;
+            }
+            std::vector<Clock::duration> arrivals = schedule(config);
+            std::deque<Login> queue;
+            std::mutex lock;
+            std::condition_variable ready;
+            bool closed = false;
+            std::vector<Recorder> recorders(config.workers);
+            LoadResult result;
+            result.offered = config.requests;
+
+            std::vector<std::thread> workers;
+            for (unsigned int w = 0; w < config.workers; w++) {
+                workers.emplace_back([&, w]() {
+                    Recorder &recorder = recorders[w];
+                    while (true) {
+                        Login login;
+                        {
+                            std::unique_lock<std::mutex> guard(lock);
+                            ready.wait(guard, [&]() { return closed || !queue.empty(); });
+                            if (queue.empty()) {
+                                return;
+                            }
+                            login = queue.front();
+                            queue.pop_front();
+                        }
+                        auto start = Clock::now();
+                        bool match = algorithm._checkHash(hashes[login.account], passwords[login.account]);
+                        auto end = Clock::now();
+                        recorder.failed += !match;
+                        recorder.queueing.record(start > login.arrival ? nanos(start - login.arrival) : 0);
+                        recorder.service.record(nanos(end - start));
+                        recorder.endToEnd.record(nanos(end - login.arrival));
+                        recorder.last = std::max(recorder.last, end);
+                    }
+                });
+            }
+
+            // The generator sleeps until each arrival; when it is late it catches up without sleeping
+            Clock::time_point begin = Clock::now();
+            for (size_t i = 0; i < arrivals.size(); i++) {
+                Clock::time_point arrival = begin + arrivals[i];
+                std::this_thread::sleep_until(arrival);
+                std::lock_guard<std::mutex> guard(lock);
+                if (queue.size() >= config.queueCapacity) {
+                    result.rejected++;
+                    continue;
+                }
+                queue.push_back({arrival, i % hashes.size()});
+                ready.notify_one();
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                closed = true;
+            }
+            ready.notify_all();
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+
+            Clock::time_point last = begin;
+            for (Recorder &recorder : recorders) {
+                result.queueing.merge(recorder.queueing);
+                result.service.merge(recorder.service);
+                result.endToEnd.merge(recorder.endToEnd);
+                result.failed += recorder.failed;
+                last = std::max(last, recorder.last);
+            }
+            result.completed = result.endToEnd.count();
+            result.elapsed = std::chrono::duration<double>(last - begin).count();
+            return result;
+        }
+
+        // A run is sustainable when nothing was rejected, completions kept up with arrivals and the
+        // 99th percentile login stayed within the objective
+        static bool sustainable(const LoadResult &result, const LoadConfig &config, double sloP99) {
+            return result.rejected == 0 && result.achievedQps() >= 0.9 * config.qps
+                && result.endToEnd.percentile(0.99) <= sloP99 * 1e9;
+        }
+};
+
+#endif // LOADSIM_HPP
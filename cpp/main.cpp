@@ -4,17 +4,25 @@
 #include "yescrypt.cpp"
 #include "scrypt.cpp"
 #include "plaintext.cpp"
+#include "attack.hpp"
+#include "cgroup.hpp"
+#include "sweep.hpp"
+#include "fingerprint.hpp"
+#include "loadsim.hpp"
+#include "tuner.hpp"
+#include "migrate.hpp"
 #include <iostream>
-#include <memory>
-#include <stdexcept>
 #include <string>
-#include <array>
 #include <vector>
+#include <thread>
 #include <unistd.h>
 #include <unordered_map>
-#include <sys/wait.h>
 
 std::vector<HashBenchmark *> default_algorithms;
+// Warmup and repetitions for the tests that report statistics
+HarnessConfig harness_config;
+// Isolated configurations queued by the parameter tests, run in parallel by sweep.run()
+SweepScheduler sweep;
 
 // yescrypt > 4096 and scrypt > 8192 require hugepages to be allocated
 // echo 200 > /proc/sys/vm/nr_hugepages
@@ -26,40 +34,52 @@ void initialize(std::vector<HashBenchmark *> &algorithms) {
     algorithms.push_back(new Scrypt("Scrypt-Mem", 1 << 17, 8, 1));
     algorithms.push_back(new Scrypt("Scrypt-Balanced", 1 << 15, 8, 3));
     algorithms.push_back(new Scrypt("Scrypt-CPU", 1 << 13, 8, 10));
+    algorithms.push_back(new Scrypt("Scrypt-CPU-Threaded", 1 << 13, 8, 10, 10, false));
     algorithms.push_back(new Yescrypt("yescrypt", 4096));
     algorithms.push_back(new Sha256("sha256"));
     algorithms.push_back(new Plaintext("Plaintext"));
 }
 
-// Execute cmd and return stdout
-// https://stackoverflow.com/questions/478898/how-do-i-execute-a-command-and-get-the-output-of-the-command-within-c-using-po
-std::string exec(const char* cmd) {
-    std::array<char, 128> buffer;
-    std::string result;
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
-    if (!pipe) {
-        throw std::runtime_error("popen() failed!");
-    }
-    while (fgets(buffer.data(), static_cast<int>(buffer.size()), pipe.get()) != nullptr) {
-        result += buffer.data();
-    }
-    return result;
+// [COUNT]x [CPU MODEL],[OS RELEASE],[KERNEL],[RAM GB],[CPUID, caches, topology, frequency, pages, libraries]
+// Collected once per run
+std::string get_hardware_string() {
+    return HostFingerprint::instance().summary();
 }
 
-// [COUNT]x [CPU MODEL], [OS RELEASE], [PYTHON VERSION], [RAM GB]
-std::string get_hardware_string() {
-    return exec("python get_hw_string.py");
+// Every host fingerprint field, for comparing results across machines
+void writeHostFingerprint() {
+    std::ofstream f("results/host.csv");
+    f << "Host fingerprint, " << get_hardware_string() << std::endl;
+    HostFingerprint::instance().writeCsv(f);
+    f.close();
 }
 
+// Run one configuration in its own process and cgroup, then append the row it wrote and the kernel's
+// accounting for that run to a csv; a configuration that writes nothing adds no row
+void runIsolated(const std::string &csv, const std::function<void(std::ostream &)> &configuration) {
+    CgroupUsage usage;
+    std::string row = CgroupRunner::instance().run(configuration, usage);
+    if (!row.empty()) {
+        appendIsolatedRow(csv, row, usage);
+    }
+}
+
+// Process, corpus and library overhead of one isolated configuration on top of its hash memory
+static const size_t job_overhead = (size_t) 64 << 20;
+
 // Computation Time (32 passwords, rockyou32.txt) on all the default algorithms
 void computationTimeTest1() {
     std::ofstream f("results/compute1.csv");
     f << "Computation Time (32 passwords, rockyou32.txt) on all the default algorithms, " << get_hardware_string() << std::endl;
-    f << "Algorithm,Time" << std::endl;
+    f << "Algorithm," << Measurement::csvHeader() << "," << PerfCounts::csvHeader() << std::endl;
     for (HashBenchmark *algorithm : default_algorithms) {
-        double elapsed_time = algorithm->computeTime("../resources/rockyou32.txt");
-        std::cout << algorithm->name << ": " << elapsed_time << " seconds" << std::endl;
-        f << algorithm->name << "," << elapsed_time << std::endl;
+        Measurement m = algorithm->computeTimeStats("../resources/rockyou32.txt", harness_config);
+        std::cout << algorithm->name << ": " << m.wall.median << " seconds (+/- " << m.wall.stddev << ", " << m.processCpu.median << " CPU seconds)" << std::endl;
+        f << algorithm->name << ",";
+        m.writeCsv(f);
+        f << ",";
+        m.counters.writeCsv(f);
+        f << std::endl;
     }
     f.close();
 }
@@ -70,43 +90,651 @@ void computationTimeTest2() {
     std::vector<HashBenchmark *> fast_algorithms = {default_algorithms[alg_len - 2], default_algorithms[alg_len - 1]};
     std::ofstream f("results/compute2.csv");
     f << "Computation Time (25k passwords, rockyou25k.txt) on the fast algorithms, " << get_hardware_string() << std::endl;
-    f << "Algorithm,Time" << std::endl;
+    f << "Algorithm," << Measurement::csvHeader() << "," << PerfCounts::csvHeader() << std::endl;
     for (HashBenchmark *algorithm : fast_algorithms) {
-        double elapsed_time = algorithm->computeTime("../resources/rockyou25k.txt");
-        std::cout << algorithm->name << ": " << elapsed_time << " seconds" << std::endl;
-        f << algorithm->name << "," << elapsed_time << std::endl;
+        Measurement m = algorithm->computeTimeStats("../resources/rockyou25k.txt", harness_config);
+        std::cout << algorithm->name << ": " << m.wall.median << " seconds (+/- " << m.wall.stddev << ", " << m.processCpu.median << " CPU seconds)" << std::endl;
+        f << algorithm->name << ",";
+        m.writeCsv(f);
+        f << ",";
+        m.counters.writeCsv(f);
+        f << std::endl;
+    }
+    f.close();
+}
+
+// Computation Time (25k passwords, rockyou25k.txt) on SHA-256, OpenSSL one-shot vs each multi-buffer kernel
+void computationTimeTest3() {
+    Sha256 alg("sha256");
+    std::ofstream f("results/compute3.csv");
+    f << "Computation Time (25k passwords, rockyou25k.txt) on SHA-256 per kernel, " << get_hardware_string() << std::endl;
+    f << "Kernel,Lanes,Time" << std::endl;
+    double elapsed_time = alg.rawComputeTime("../resources/rockyou25k.txt");
+    std::cout << "openssl: " << elapsed_time << " seconds" << std::endl;
+    f << "openssl,1," << elapsed_time << std::endl;
+    for (sha256_mb::Isa isa : sha256_mb::allIsas) {
+        if (!sha256_mb::isaSupported(isa)) {
+            continue;
+        }
+        elapsed_time = alg.batchComputeTime("../resources/rockyou25k.txt", isa);
+        std::cout << sha256_mb::isaName(isa) << ": " << elapsed_time << " seconds" << std::endl;
+        f << sha256_mb::isaName(isa) << "," << sha256_mb::lanes(isa) << "," << elapsed_time << std::endl;
+    }
+    f.close();
+}
+
+// Computation Time (32 passwords, rockyou32.txt) on PBKDF2, OpenSSL vs each lane-parallel kernel
+void computationTimeTest4() {
+    std::ofstream f("results/compute4.csv");
+    f << "Computation Time (32 passwords, rockyou32.txt) on PBKDF2 per kernel, " << get_hardware_string() << std::endl;
+    f << "Iters,Kernel,Lanes,Time" << std::endl;
+    for (int iters : {100000, 600000, 1000000}) {
+        Pbkdf2 alg("PBKDF2", iters);
+        double elapsed_time = alg.rawComputeTime("../resources/rockyou32.txt");
+        std::cout << iters << " openssl: " << elapsed_time << " seconds" << std::endl;
+        f << iters << ",openssl,1," << elapsed_time << std::endl;
+        for (sha256_mb::Isa isa : sha256_mb::allIsas) {
+            if (!sha256_mb::isaSupported(isa)) {
+                continue;
+            }
+            elapsed_time = alg.batchComputeTime("../resources/rockyou32.txt", isa);
+            std::cout << iters << " " << sha256_mb::isaName(isa) << ": " << elapsed_time << " seconds" << std::endl;
+            f << iters << "," << sha256_mb::isaName(isa) << "," << sha256_mb::lanes(isa) << "," << elapsed_time << std::endl;
+        }
+    }
+    f.close();
+}
+
+// Computation Time on every default algorithm, one _hash call per password vs one hashBatch call
+// 32 passwords (rockyou32.txt) for all, 25k (rockyou25k.txt) for the fast ones
+void computationTimeTest5() {
+    std::ofstream f("results/compute5.csv");
+    f << "Computation Time per-call vs batch API (rockyou32.txt on all, rockyou25k.txt on the fast algorithms), " << get_hardware_string() << std::endl;
+    f << "Algorithm,Passwords,PerCall,Batch" << std::endl;
+    size_t alg_len = default_algorithms.size();
+    for (size_t i = 0; i < alg_len; i++) {
+        HashBenchmark *algorithm = default_algorithms[i];
+        std::vector<std::pair<std::string, std::string>> files = {{"32", "../resources/rockyou32.txt"}};
+        if (i >= alg_len - 2) {
+            files.push_back({"25k", "../resources/rockyou25k.txt"});
+        }
+        for (auto &[count, file] : files) {
+            double per_call = algorithm->computeTime(file);
+            double batch = algorithm->computeTimeBatch(file);
+            std::cout << algorithm->name << " " << count << ": " << per_call << " / " << batch << " seconds" << std::endl;
+            f << algorithm->name << "," << count << "," << per_call << "," << batch << std::endl;
+        }
+    }
+    f.close();
+}
+
+// Computation Time (32 passwords, rockyou32.txt) on Argon2id t=3 m=64MiB per BlaMka kernel vs libargon2,
+// at 1 lane and at the default 4; throughput is block memory filled per second, all passes counted
+// Every kernel must first match libargon2 byte for byte on Argon2d, i and id, versions 0x10 and 0x13,
+// 1 to 4 lanes, short and long tags, secret and associated data, and RFC 9106's Argon2id vector
+void computationTimeTest6() {
+    uint8_t pwd[32], salt[16], secret[8], ad[12], expected[128], out[128];
+    memset(pwd, 0x01, sizeof(pwd));
+    memset(salt, 0x02, sizeof(salt));
+    memset(secret, 0x03, sizeof(secret));
+    memset(ad, 0x04, sizeof(ad));
+    const uint8_t rfc9106[32] = {
+        0x0d, 0x64, 0x0d, 0xf5, 0x8d, 0x78, 0x76, 0x6c, 0x08, 0xc0, 0x37, 0xa3, 0x4a, 0x8b, 0x53, 0xc9,
+        0xd0, 0x1e, 0xf0, 0x45, 0x2d, 0x75, 0xb6, 0x5e, 0xb5, 0x25, 0x20, 0xe9, 0x6b, 0x01, 0xe6, 0x59
+    };
+    struct Case { argon2_type type; uint32_t version, t, m, p, outlen; bool keyed; };
+    std::vector<Case> cases = {{Argon2_id, ARGON2_VERSION_13, 3, 32, 4, 32, true}};
+    for (argon2_type type : {Argon2_d, Argon2_i, Argon2_id}) {
+        cases.push_back({type, ARGON2_VERSION_13, 1, 8, 1, 4, false});
+        cases.push_back({type, ARGON2_VERSION_13, 2, 1024, 1, 100, true});
+        cases.push_back({type, ARGON2_VERSION_13, 3, 300, 3, 32, false});
+        cases.push_back({type, ARGON2_VERSION_10, 2, 512, 4, 64, true});
+    }
+    for (const Case &c : cases) {
+        argon2_context ctx = {
+            expected, c.outlen, pwd, sizeof(pwd), salt, sizeof(salt),
+            c.keyed ? secret : NULL, c.keyed ? (uint32_t) sizeof(secret) : 0,
+            c.keyed ? ad : NULL, c.keyed ? (uint32_t) sizeof(ad) : 0,
+            c.t, c.m, c.p, c.p, c.version, NULL, NULL, ARGON2_DEFAULT_FLAGS,
+        };
+        assert(argon2_ctx(&ctx, c.type) == ARGON2_OK);
+        assert(&c != &cases[0] || memcmp(expected, rfc9106, sizeof(rfc9106)) == 0);
+        for (argon2_core::Isa isa : argon2_core::allIsas) {
+            if (!argon2_core::isaSupported(isa)) {
+                continue;
+            }
+            ctx.out = out;
+            assert(argon2_core::ctx(&ctx, c.type, isa) == ARGON2_OK);
+            assert(memcmp(out, expected, c.outlen) == 0);
+        }
+    }
+
+    std::ofstream f("results/compute6.csv");
+    f << "Computation Time (32 passwords, rockyou32.txt) on Argon2id t=3 m=65536 per BlaMka kernel, " << get_hardware_string() << std::endl;
+    f << "Kernel,Lanes,Time,Throughput(MiB/s),Selected" << std::endl;
+    const uint32_t timecost = 3, memcost = 65536;
+    const Corpus &passwords = Corpus::load("../resources/rockyou32.txt");
+    double mib = (double) memcost / 1024 * timecost * passwords.size();
+    for (uint32_t lanes : {1, 4}) {
+        uint8_t hash[32];
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < passwords.size(); i++) {
+            std::string_view password = passwords[i];
+            SaltProvider::fill((char *) salt, sizeof(salt));
+            assert(argon2id_hash_raw(timecost, memcost, lanes, password.data(), password.size(), salt, sizeof(salt), hash, sizeof(hash)) == ARGON2_OK);
+        }
+        double elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "libargon2 p=" << lanes << ": " << elapsed_time << " seconds" << std::endl;
+        f << "libargon2," << lanes << "," << elapsed_time << "," << mib / elapsed_time << ",0" << std::endl;
+        for (argon2_core::Isa isa : argon2_core::allIsas) {
+            Argon2 alg("Argon2", timecost, memcost, lanes, false);
+            if (!alg.setIsa(isa)) {
+                continue;
+            }
+            elapsed_time = alg.computeTime("../resources/rockyou32.txt");
+            std::cout << argon2_core::isaName(isa) << " p=" << lanes << ": " << elapsed_time << " seconds" << std::endl;
+            f << argon2_core::isaName(isa) << "," << lanes << "," << elapsed_time << "," << mib / elapsed_time << ","
+              << (isa == argon2_core::defaultIsa()) << std::endl;
+        }
+    }
+    f.close();
+}
+
+// Computation Time (32 passwords, rockyou32.txt) on the scrypt defaults, libxcrypt vs every in-tree
+// ROMix kernel on one thread and on p threads
+// Every kernel is first checked against libxcrypt's $7$ on the same settings and against OpenSSL,
+// including p that are not a multiple of the instances a kernel runs at once
+// Selected marks the kernel and thread count the default, sequential Scrypt runs
+void computationTimeTest7() {
+    struct Case { int n, r, p; };
+    for (Case c : std::vector<Case>{{1 << 4, 1, 1}, {1 << 10, 8, 2}, {1 << 8, 2, 3}, {1 << 6, 3, 5}, {1 << 10, 1, 7}, {1 << 12, 8, 10}}) {
+        Scrypt alg("Scrypt", c.n, c.r, c.p);
+        for (const char *password : {"", "password", "pleaseletmein"}) {
+            std::string hash = alg._hash(password);
+            // libxcrypt rebuilds the key from the setting in the record
+            assert(hash == cryptReentrant(password, hash.c_str()));
+            char phc[PHC_MAX_LENGTH];
+            PhcRecord rec;
+            assert(alg.phcHash(password, phc) > 0 && phc::decode(phc, rec));
+            uint8_t key[32];
+            assert(EVP_PBE_scrypt(password, strlen(password), rec.salt, rec.saltLen, c.n, c.r, c.p, (uint64_t) 1 << 32, key, sizeof(key)) == 1);
+            assert(phc::digestEqual(key, rec.hash, sizeof(key)));
+            for (scrypt_core::Isa isa : scrypt_core::allIsas) {
+                for (unsigned int threads : {1, 2, 4}) {
+                    Scrypt other("Scrypt", c.n, c.r, c.p, threads, threads == 2);
+                    if (!other.setIsa(isa)) {
+                        continue;
+                    }
+                    assert(other._checkHash(hash, password));
+                    assert(!other._checkHash(hash, "passwore"));
+                    assert(other.phcVerify(phc, password));
+                }
+            }
+        }
+    }
+
+    std::ofstream f("results/compute7.csv");
+    f << "Computation Time (32 passwords, rockyou32.txt) on scrypt per ROMix kernel and thread count, " << get_hardware_string() << std::endl;
+    f << "Algorithm,Kernel,Threads,Time,MemoryCost(KB),Selected" << std::endl;
+    const Corpus &passwords = Corpus::load("../resources/rockyou32.txt");
+    struct Config { const char *name; int n, r, p; };
+    for (Config c : std::vector<Config>{{"Scrypt-Balanced", 1 << 15, 8, 3}, {"Scrypt-CPU", 1 << 13, 8, 10}}) {
+        char setting[64];
+        Scrypt alg(c.name, c.n, c.r, c.p);
+        std::string hash = alg._hash("password");
+        // Same parameters, libxcrypt's own salt per password
+        snprintf(setting, sizeof(setting), "%.*s", (int) hash.rfind('$') + 1, hash.c_str());
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < passwords.size(); i++) {
+            assert(cryptView(passwords[i], setting) != NULL);
+        }
+        double elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << c.name << " libxcrypt: " << elapsed_time << " seconds" << std::endl;
+        f << c.name << ",libxcrypt,1," << elapsed_time << "," << (size_t) 128 * c.r * c.n / 1024 << ",0" << std::endl;
+        for (scrypt_core::Isa isa : scrypt_core::allIsas) {
+            for (unsigned int threads : {1, c.p}) {
+                Scrypt native(c.name, c.n, c.r, c.p, threads, false);
+                if (!native.setIsa(isa)) {
+                    continue;
+                }
+                elapsed_time = native.computeTime("../resources/rockyou32.txt");
+                std::cout << c.name << " " << scrypt_core::isaName(isa) << " threads=" << threads << ": " << elapsed_time << " seconds" << std::endl;
+                f << c.name << "," << scrypt_core::isaName(isa) << "," << threads << "," << elapsed_time << "," << native.memoryCost() / 1024 << ","
+                  << (isa == alg.kernel() && threads == 1) << std::endl;
+            }
+        }
+    }
+    f.close();
+}
+
+// Verification Time on every default algorithm, legacy strings with _checkHash vs PHC strings with phcVerify
+// 32 passwords (rockyou32.txt) for all, 25k (rockyou25k.txt) for the fast ones
+// PHC strings are first checked against independent implementations and for rejecting wrong input
+// and parameters over the cost policy
+void test_phc_verify() {
+    std::ofstream f("results/phc.csv");
+    f << "Verification Time legacy vs PHC strings (rockyou32.txt on all, rockyou25k.txt on the fast algorithms), " << get_hardware_string() << std::endl;
+    f << "Algorithm,Passwords,Legacy,Phc" << std::endl;
+    char phc[PHC_MAX_LENGTH];
+    size_t alg_len = default_algorithms.size();
+    for (size_t i = 0; i < alg_len; i++) {
+        HashBenchmark *algorithm = default_algorithms[i];
+        size_t len = algorithm->phcHash("password", phc);
+        assert(len > 0 && len == strlen(phc));
+        assert(algorithm->phcVerify(phc, "password"));
+        assert(!algorithm->phcVerify(phc, "passwore"));
+        assert(!algorithm->phcVerify(std::string_view(phc, len - 1), "password"));
+        PhcRecord rec;
+        char again[PHC_MAX_LENGTH];
+        assert(phc::decode(phc, rec) && phc::encode(rec, again, sizeof(again)) == len && strcmp(again, phc) == 0);
+        // libargon2 reads the same encoding, and OpenSSL derives the same scrypt key from the stored salt
+        if (strcmp(rec.id, "argon2id") == 0) {
+            assert(argon2id_verify(phc, "password", 8) == ARGON2_OK);
+        } else if (strcmp(rec.id, "scrypt") == 0) {
+            uint64_t ln, r, p;
+            assert(rec.param("ln", ln) && rec.param("r", r) && rec.param("p", p));
+            unsigned char key[PhcRecord::maxHash];
+            assert(EVP_PBE_scrypt("password", 8, rec.salt, rec.saltLen, (uint64_t) 1 << ln, r, p, (uint64_t) 1 << 32, key, rec.hashLen) == 1);
+            assert(phc::digestEqual(key, rec.hash, rec.hashLen));
+            // The legacy $7$ reader applies the same cap; N = 2^40 would be a 128 TiB V
+            std::string legacy = algorithm->_hash("password");
+            legacy[3] = base64_table[40];
+            assert(!algorithm->_checkHash(legacy, "password"));
+        } else if (strcmp(rec.id, "yescrypt") == 0) {
+            // So does the $y$ reader, and a setting libxcrypt refuses is a mismatch, not an abort
+            std::string legacy = algorithm->_hash("password");
+            legacy[4] = base64_table[40];
+            assert(!algorithm->_checkHash(legacy, "password"));
+            assert(!algorithm->_checkHash("$y$jcT$abcdabcd$xyz", "a"));
+            // Nor is a short string read past its end, or a multi-char r taken for one char
+            assert(!algorithm->_checkHash("$y", "a") && !algorithm->_checkHash("$y$j", "a"));
+            legacy = algorithm->_hash("password");
+            legacy[5] = base64_table[48];
+            assert(!algorithm->_checkHash(legacy, "password"));
+        }
+        // Any cost parameter blown up past the policy is refused before deriving, not run
+        for (size_t k = 0; k < rec.paramCount; k++) {
+            PhcRecord costly = rec;
+            bool logarithmic = strcmp(costly.params[k].name, "ln") == 0 || strcmp(costly.params[k].name, "nrom") == 0;
+            costly.params[k].value = logarithmic ? 40 : (uint64_t) 1 << 40;
+            char crafted[PHC_MAX_LENGTH];
+            assert(phc::encode(costly, crafted, sizeof(crafted)) > 0 && !algorithm->phcVerify(crafted, "password"));
+        }
+
+        std::vector<std::pair<std::string, std::string>> files = {{"32", "../resources/rockyou32.txt"}};
+        if (i >= alg_len - 2) {
+            files.push_back({"25k", "../resources/rockyou25k.txt"});
+        }
+        for (auto &[count, file] : files) {
+            double legacy = algorithm->verifyTime(file, false);
+            double phc_time = algorithm->verifyTime(file, true);
+            std::cout << algorithm->name << " " << count << ": " << legacy << " / " << phc_time << " seconds" << std::endl;
+            f << algorithm->name << "," << count << "," << legacy << "," << phc_time << std::endl;
+        }
+    }
+    f.close();
+
+    // An instance configured past the policy still hashes and verifies its own records: a 1 GiB V
+    // plus B, p over maxLanes and past one setting char, and yescrypt with the policy pulled below its own memory
+    Scrypt big("Scrypt-1G", 1 << 20, 8, 1), wide("Scrypt-p64", 1 << 10, 8, 64);
+    Yescrypt tight("yescrypt-tight", 1 << 14), tightNative("yescrypt-tight-native", 1 << 14, nullptr);
+    tight.costPolicy.maxMemory = tightNative.costPolicy.maxMemory = (size_t) 1 << 20;
+    for (HashBenchmark *algorithm : std::initializer_list<HashBenchmark *>{&big, &wide, &tight, &tightNative}) {
+        std::string own = algorithm->_hash("password");
+        assert(!own.empty() && algorithm->_checkHash(own, "password") && !algorithm->_checkHash(own, "passwore"));
+        assert(algorithm->phcHash("password", phc) > 0 && algorithm->phcVerify(phc, "password"));
+    }
+}
+
+// Dictionary attack on every default algorithm: a leaked file of PHC hashes against a wordlist
+// Fast algorithms: 1000 targets, every 50th password of rockyou25k.txt and 500 that are in no wordlist
+// Slow ones: 4 targets from rockyou32.txt, 2 of them crackable; every crack is checked with phcVerify
+void test_dictionary_attack() {
+    std::ofstream f("results/attack.csv");
+    f << "Dictionary attack (rockyou25k.txt on the fast algorithms, rockyou32.txt on the rest), " << get_hardware_string() << std::endl;
+    f << "Algorithm," << AttackResult::csvHeader() << std::endl;
+    const std::string target_file = "results/attack_targets.txt";
+    unsigned int max_threads = std::thread::hardware_concurrency();
+    size_t alg_len = default_algorithms.size();
+    char phc[PHC_MAX_LENGTH];
+    for (size_t i = 0; i < alg_len; i++) {
+        HashBenchmark *algorithm = default_algorithms[i];
+        bool fast = i >= alg_len - 2;
+        const Corpus &wordlist = Corpus::load(fast ? "../resources/rockyou25k.txt" : "../resources/rockyou32.txt");
+        size_t targets = fast ? 1000 : 4;
+        size_t stride = fast ? 50 : 15;
+
+        std::ofstream t(target_file);
+        size_t crackable = 0;
+        for (size_t j = 0; j < targets; j++) {
+            if (j % 2 == 0) {
+                algorithm->phcHash(wordlist[(j / 2 * stride + 5) % wordlist.size()], phc);
+                crackable++;
+            } else {
+                algorithm->phcHash("not in any wordlist " + std::to_string(j), phc);
+            }
+            t << phc << "\n";
+        }
+        t.close();
+
+        DictionaryAttack attack(*algorithm, target_file);
+        for (unsigned int threads : {1u, max_threads}) {
+            AttackResult result = attack.run(wordlist, threads, fast ? 64 : 1);
+            assert(result.cracked == crackable);
+            for (size_t j = 0; j < attack.targetCount(); j++) {
+                assert(!attack.password(j).empty() == (j % 2 == 0));
+                assert(j % 2 != 0 || algorithm->phcVerify(attack.target(j), attack.password(j)));
+            }
+            std::cout << algorithm->name << " x" << result.threads << ": " << result.cracked << "/" << result.targets << " cracked, "
+                      << result.guessesPerSecond() << " guesses/s, " << result.cpuPerCrack() << " CPU s/crack" << std::endl;
+            f << algorithm->name << ",";
+            result.writeCsv(f);
+            f << std::endl;
+            if (max_threads == 1) {
+                break;
+            }
+        }
+    }
+    std::remove(target_file.c_str());
+    f.close();
+}
+
+// Brute-force Time on the fast algorithms: rockyou25k.txt, and the full rockyou.txt when it is in resources
+// Mapping and indexing a corpus is timed once, apart from the hashing that then shares it
+void bruteForceTest1() {
+    size_t alg_len = default_algorithms.size();
+    std::vector<HashBenchmark *> fast_algorithms = {default_algorithms[alg_len - 2], default_algorithms[alg_len - 1]};
+    std::ofstream f("results/bruteforce1.csv");
+    f << "Brute-force Time (rockyou25k.txt, rockyou.txt if present) on the fast algorithms, " << get_hardware_string() << std::endl;
+    f << "File,Passwords,LoadTime,Algorithm,Time" << std::endl;
+    for (std::string file : {"../resources/rockyou25k.txt", "../resources/rockyou.txt"}) {
+        if (access(file.c_str(), R_OK) != 0) {
+            continue;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t count = Corpus::load(file).size();
+        auto end = std::chrono::high_resolution_clock::now();
+        double load_time = std::chrono::duration<double>(end - start).count();
+        std::cout << file << ": " << count << " passwords loaded in " << load_time << " seconds" << std::endl;
+        for (HashBenchmark *algorithm : fast_algorithms) {
+            double elapsed_time = algorithm->bruteForceTime(file);
+            std::cout << algorithm->name << ": " << elapsed_time << " seconds" << std::endl;
+            f << file << "," << count << "," << load_time << "," << algorithm->name << "," << elapsed_time << std::endl;
+        }
+    }
+    f.close();
+}
+
+// Salt generation time (25k salts of 16 bytes) per salt provider, and PBKDF2-100k time (32 passwords,
+// rockyou32.txt) under each, separating salt cost from KDF cost
+// Seeded mode must reproduce the same salts after a reset
+void test_salt_providers() {
+    std::ofstream f("results/salt.csv");
+    f << "Salt generation (25k salts) and PBKDF2-100k time (32 passwords, rockyou32.txt) per salt provider, " << get_hardware_string() << std::endl;
+    f << "Provider,SaltTime(s),Pbkdf2Time(s)" << std::endl;
+    SaltMode original = SaltProvider::getMode();
+    for (SaltMode mode : {SALT_URANDOM, SALT_POOL, SALT_SEEDED}) {
+        SaltProvider::setMode(mode, 1337);
+        char salt[16];
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < 25000; i++) {
+            SaltProvider::fill(salt, sizeof(salt));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double salt_time = std::chrono::duration<double>(end - start).count();
+        Pbkdf2 alg("PBKDF2-100k", 100000);
+        double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
+        std::cout << saltModeName(mode) << ": " << salt_time << " seconds for salts, " << elapsed_time << " seconds for PBKDF2" << std::endl;
+        f << saltModeName(mode) << "," << salt_time << "," << elapsed_time << std::endl;
+    }
+    char first[64], second[64];
+    SaltProvider::setMode(SALT_SEEDED, 1337);
+    SaltProvider::fill(first, sizeof(first));
+    SaltProvider::setMode(SALT_SEEDED, 1337);
+    SaltProvider::fill(second, sizeof(second));
+    assert(memcmp(first, second, sizeof(first)) == 0);
+    SaltProvider::setMode(original);
+    f.close();
+}
+
+// Throughput of hashing a file on 1..nproc worker threads, appended to an open csv
+// Speedup and efficiency are relative to the single-thread run of the same algorithm, from median times
+// Argon2 already runs 4 lanes on 4 threads per hash, so its curve flattens earlier; CPU seconds show the cost
+void scalingTest(std::ofstream &f, HashBenchmark *algorithm, std::string passwordFile, size_t count) {
+    unsigned int max_threads = std::thread::hardware_concurrency();
+    if (!algorithm->reentrant()) {
+        max_threads = 1;
+    }
+    double base_rate = 0;
+    for (unsigned int threads = 1; threads <= max_threads; threads++) {
+        Measurement m = algorithm->computeTimeParallelStats(passwordFile, threads, harness_config);
+        double elapsed_time = m.wall.median;
+        double rate = count / elapsed_time;
+        if (threads == 1) {
+            base_rate = rate;
+        }
+        double speedup = rate / base_rate;
+        std::cout << algorithm->name << " x" << threads << ": " << rate << " hashes/s, speedup " << speedup << std::endl;
+        f << algorithm->name << "," << threads << "," << elapsed_time << "," << rate << "," << speedup << "," << speedup / threads << "," << m.wall.stddev << "," << m.processCpu.median << std::endl;
+    }
+}
+
+// Multi-threaded throughput (100 passwords, rockyou100.txt) on all the default algorithms
+void scalingTest1() {
+    std::ofstream f("results/scaling1.csv");
+    f << "Multi-threaded throughput (100 passwords, rockyou100.txt) on all the default algorithms, " << get_hardware_string() << std::endl;
+    f << "Algorithm,Threads,Time(s),Hashes/s,Speedup,Efficiency,Stddev(s),ProcessCpu(s)" << std::endl;
+    for (HashBenchmark *algorithm : default_algorithms) {
+        scalingTest(f, algorithm, "../resources/rockyou100.txt", 100);
     }
     f.close();
 }
 
+// Multi-threaded throughput (25k passwords, rockyou25k.txt) on the fast algorithms
+void scalingTest2() {
+    size_t alg_len = default_algorithms.size();
+    std::vector<HashBenchmark *> fast_algorithms = {default_algorithms[alg_len - 2], default_algorithms[alg_len - 1]};
+    std::ofstream f("results/scaling2.csv");
+    f << "Multi-threaded throughput (25k passwords, rockyou25k.txt) on the fast algorithms, " << get_hardware_string() << std::endl;
+    f << "Algorithm,Threads,Time(s),Hashes/s,Speedup,Efficiency,Stddev(s),ProcessCpu(s)" << std::endl;
+    for (HashBenchmark *algorithm : fast_algorithms) {
+        scalingTest(f, algorithm, "../resources/rockyou25k.txt", 25000);
+    }
+    f.close();
+}
+
+// Append one histogram's percentiles and non-empty buckets to the summary and bucket csvs
+void writeLatency(std::ofstream &summary, std::ofstream &buckets, const std::string &prefix, const LatencyHistogram &h) {
+    summary << prefix << "," << h.count() << "," << h.min() << "," << h.mean() << "," << h.percentile(0.5) << ","
+            << h.percentile(0.9) << "," << h.percentile(0.99) << "," << h.percentile(0.999) << "," << h.max() << std::endl;
+    for (size_t i = 0; i < h.buckets(); i++) {
+        if (h.bucket(i) != 0) {
+            buckets << prefix << "," << LatencyHistogram::lowerBound(i) << "," << LatencyHistogram::upperBound(i) << "," << h.bucket(i) << std::endl;
+        }
+    }
+}
+
+// Per-call latency of hash and verify on 1..nproc worker threads
+// rockyou100.txt on all the default algorithms, rockyou25k.txt on the fast ones; with 100 calls
+// p999 is simply the slowest call
+void test_latency_histograms() {
+    std::ofstream summary("results/latency.csv");
+    std::ofstream buckets("results/latency_buckets.csv");
+    summary << "Per-call hash/verify latency (ns) per concurrency level, " << get_hardware_string() << std::endl;
+    summary << "Algorithm,Passwords,Threads,Op,Count,Min,Mean,P50,P90,P99,P999,Max" << std::endl;
+    buckets << "Per-call hash/verify latency histogram buckets (ns) per concurrency level, " << get_hardware_string() << std::endl;
+    buckets << "Algorithm,Passwords,Threads,Op,Low,High,Count" << std::endl;
+    size_t alg_len = default_algorithms.size();
+    for (size_t i = 0; i < alg_len; i++) {
+        HashBenchmark *algorithm = default_algorithms[i];
+        std::vector<std::pair<std::string, std::string>> files = {{"100", "../resources/rockyou100.txt"}};
+        if (i >= alg_len - 2) {
+            files.push_back({"25k", "../resources/rockyou25k.txt"});
+        }
+        unsigned int max_threads = algorithm->reentrant() ? std::thread::hardware_concurrency() : 1;
+        for (auto &[count, file] : files) {
+            for (unsigned int threads = 1; threads <= max_threads; threads++) {
+                LatencyProfile profile = algorithm->latencyProfile(file, threads);
+                std::string prefix = algorithm->name + "," + count + "," + std::to_string(threads);
+                std::cout << algorithm->name << " " << count << " x" << threads << ": hash p99 " << profile.hash.percentile(0.99)
+                          << " ns, verify p99 " << profile.check.percentile(0.99) << " ns" << std::endl;
+                writeLatency(summary, buckets, prefix + ",hash", profile.hash);
+                writeLatency(summary, buckets, prefix + ",verify", profile.check);
+            }
+        }
+    }
+    summary.close();
+    buckets.close();
+}
+
+// Open-loop login load on every default algorithm: Poisson and bursty arrivals at fractions of the
+// closed-loop capacity (workers / mean _checkHash time), then bisection for the highest sustainable rate
+// Sustainable means no rejected logins, throughput kept up and p99 end-to-end within 10 service times
+// per login arriving together (at least 10 ms); each point offers 40 logins on the slow algorithms and
+// 2 s worth on the fast ones
+void loadTest(std::ofstream &f, std::ofstream &max_f, HashBenchmark *algorithm, ArrivalPattern pattern) {
+    LoadSimulator sim(*algorithm, "../resources/rockyou32.txt", 32);
+    LoadConfig config;
+    config.pattern = pattern;
+    config.workers = algorithm->reentrant() ? std::thread::hardware_concurrency() : 1;
+    double service = sim.serviceTime();
+    double capacity = config.workers / service;
+    double slo = std::max(10 * service * (pattern == ARRIVAL_BURSTY ? config.burstSize : 1), 0.01);
+    double best = 0, worst = 0;
+    auto point = [&](double load) {
+        config.qps = load * capacity;
+        config.requests = std::max((size_t) 40, std::min((size_t) 20000, (size_t) (2 * config.qps)));
+        LoadResult result = sim.run(config);
+        assert(result.failed == 0);
+        bool ok = LoadSimulator::sustainable(result, config, slo);
+        std::cout << algorithm->name << " " << arrivalPatternName(pattern) << " " << config.qps << " qps: p99 "
+                  << result.endToEnd.percentile(0.99) / 1e6 << " ms" << (ok ? "" : ", not sustainable") << std::endl;
+        f << algorithm->name << "," << arrivalPatternName(pattern) << "," << config.workers << "," << capacity << ","
+          << load << "," << config.qps << ",";
+        result.writeCsv(f);
+        f << "," << ok << std::endl;
+        return ok;
+    };
+    for (double load : {0.5, 0.8, 1.0, 1.2}) {
+        if (point(load)) {
+            best = load;
+        } else if (worst == 0) {
+            worst = load;
+        }
+    }
+    // Far below capacity when handing logins to the pool costs more than checking them
+    for (double load = 0.25; best == 0 && load > 0.001; load /= 2) {
+        if (point(load)) {
+            best = load;
+        } else {
+            worst = load;
+        }
+    }
+    if (worst == 0) {
+        worst = 1.5;
+    }
+    for (int step = 0; step < 2 && best < worst; step++) {
+        double mid = (best + worst) / 2;
+        if (point(mid)) {
+            best = mid;
+        } else {
+            worst = mid;
+        }
+    }
+    max_f << algorithm->name << "," << arrivalPatternName(pattern) << "," << config.workers << "," << service << ","
+          << capacity << "," << best * capacity << std::endl;
+}
+
+void test_login_load() {
+    std::ofstream f("results/load.csv");
+    std::ofstream max_f("results/load_max.csv");
+    f << "Open-loop login load (rockyou32.txt accounts) on all the default algorithms, " << get_hardware_string() << std::endl;
+    f << "Algorithm,Pattern,Workers,Capacity(qps),Load,Qps," << LoadResult::csvHeader() << ",Sustainable" << std::endl;
+    max_f << "Maximum sustainable login rate on all the default algorithms, " << get_hardware_string() << std::endl;
+    max_f << "Algorithm,Pattern,Workers,ServiceTime(s),Capacity(qps),MaxSustainableQps" << std::endl;
+    for (HashBenchmark *algorithm : default_algorithms) {
+        for (ArrivalPattern pattern : {ARRIVAL_POISSON, ARRIVAL_BURSTY}) {
+            loadTest(f, max_f, algorithm, pattern);
+        }
+    }
+    f.close();
+    max_f.close();
+}
+
+// Strongest configuration per algorithm within a budget: 250 ms p99 with every core hashing at once and
+// 256 MiB per hash; Argon2 is tuned at 1, 2 and 4 lanes and the strongest kept
+// Every candidate measured goes to tune_trials.csv
+void test_parameter_tuner() {
+    TuneBudget budget;
+    budget.concurrency = std::thread::hardware_concurrency();
+    ParameterTuner tuner(budget, "../resources/rockyou32.txt");
+    uint64_t budget_kib = budget.memoryBytes / 1024;
+
+    std::vector<TuneSpace> spaces;
+    for (unsigned int lanes : {1u, 2u, 4u}) {
+        spaces.push_back({"Argon2-p" + std::to_string(lanes), {"m", 8 * lanes, budget_kib, 0.05, false}, {"t", 1, 64, 0, false},
+            [lanes](uint64_t m, uint64_t t) { return new Argon2("Argon2", t, m, lanes, false); }});
+    }
+    // One thread per hash, so p stays a time knob instead of spreading over cores
+    spaces.push_back({"Scrypt", {"N", 10, 30, 0, true}, {"p", 1, 64, 0, false},
+        [](uint64_t n, uint64_t p) { return new Scrypt("Scrypt", n, 8, p, 1, false); }});
+    spaces.push_back({"yescrypt", {"N", 10, 30, 0, true}, {"p", 1, 1, 0, false},
+        [](uint64_t n, uint64_t) { return new Yescrypt("yescrypt", n); }});
+    spaces.push_back({"PBKDF2", {"-", 0, 0, 0, false}, {"i", 10000, 100000000, 0.02, false},
+        [](uint64_t, uint64_t i) { return new Pbkdf2("PBKDF2", i); }});
+
+    std::ofstream f("results/tune.csv");
+    f << "Parameter tuning (" << budget.p99Latency << " s p99, " << budget.memoryBytes << " B per hash, "
+      << budget.concurrency << " concurrent), " << get_hardware_string() << std::endl;
+    f << "Algorithm,Found,Memory,Time,Strength,P50(s),P99(s),CpuPerHash(s),MemoryBytes,Evaluations,Chosen" << std::endl;
+    std::vector<TuneResult> results;
+    for (const TuneSpace &space : spaces) {
+        auto start = std::chrono::high_resolution_clock::now();
+        results.push_back(tuner.tune(space));
+        auto end = std::chrono::high_resolution_clock::now();
+        const TuneResult &r = results.back();
+        assert(!r.found || r.cost.fits);
+        std::cout << r.algorithm << ": " << space.memory.name << "=" << r.memory << " " << space.time.name << "=" << r.time
+                  << ", p99 " << r.cost.p99 << " s after " << r.evaluations << " evaluations in "
+                  << std::chrono::duration<double>(end - start).count() << " seconds" << std::endl;
+    }
+    // Lane counts compete for the single Argon2 entry
+    size_t best_argon2 = 0;
+    for (size_t i = 1; i < 3; i++) {
+        if (results[i].strength > results[best_argon2].strength) {
+            best_argon2 = i;
+        }
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        const TuneResult &r = results[i];
+        f << r.algorithm << "," << r.found << "," << r.memory << "," << r.time << "," << r.strength << "," << r.cost.p50 << ","
+          << r.cost.p99 << "," << r.cost.cpuPerHash << "," << r.cost.memory << "," << r.evaluations << ","
+          << (i >= 3 || i == best_argon2) << std::endl;
+    }
+    f.close();
+
+    std::ofstream trials("results/tune_trials.csv");
+    trials << "Parameter tuning trials, " << get_hardware_string() << std::endl;
+    trials << ParameterTuner::trialCsvHeader() << std::endl;
+    tuner.writeTrials(trials);
+    trials.close();
+}
+
 // Memory Use (32 passwords, rockyou32.txt) on all the default algorithms
-// fork is required for memory benchmarking to keep maxrss stats independent
-// hugepage_scout.py is used to check hugepage usage as it is not reported via getrusage(2)
+// Each algorithm runs in its own process and cgroup to keep maxrss stats independent
+// Hugepages are not reported via getrusage(2); memory.peak covers them where the kernel charges hugetlb to memcg
 // Specifically required for yescrypt > 4096 and scrypt > 8192
 void memoryUseTest1() {
     std::ofstream f("results/memory1.csv");
     f << "Memory Use (32 passwords, rockyou32.txt) on all the default algorithms, " << get_hardware_string() << std::endl;
-    f << "Algorithm,Max Usage" << std::endl;
+    f << "Algorithm,Max Usage," << CgroupUsage::csvHeader() << std::endl;
     f.close();
     for (HashBenchmark *algorithm : default_algorithms) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            std::ofstream f1("results/memory1.csv", std::ios_base::app);
+        sweep.add({"results/memory1.csv", algorithm->memoryCost(), job_overhead, 1, false, [=](std::ostream &f1) {
             int max_usage = algorithm->memoryFootprint("../resources/rockyou32.txt");
             std::cout << algorithm->name << ": Max usage " << max_usage << " KiB" << std::endl;
-            f1 << algorithm->name << "," << max_usage * 1024 << std::endl;
-            f1.close();
-            _exit(0);
-        } else {
-            pid_t pid2 = fork();
-            if (pid2 == 0) {
-                const char *const args[3] = {"python", "hugepage_scout.py", NULL};
-                execvp("python", const_cast<char *const *>(args));
-                assert(false);
-            }
-            waitpid(pid, NULL, 0);
-            kill(pid2, SIGINT);
-        }
+            f1 << algorithm->name << "," << max_usage * 1024;
+        }});
     }
 }
 
@@ -114,22 +742,42 @@ void memoryUseTest1() {
 void test_argon2_memory_param() {
     std::ofstream f("results/incr_argon2_mem.csv");
     f << "Computation Time (32 passwords, rockyou32.txt) on Argon2id with increasing memory cost, " << get_hardware_string() << std::endl;
-    f << "Memcost(B),Time(s),MemoryUsage(KB)" << std::endl;
+    f << "Memcost(B),Time(s),MemoryUsage(KB)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
     f.close();
     int memcost = 65536;
     for (int i = 0; i < 5; i++) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            std::ofstream f1("results/incr_argon2_mem.csv", std::ios_base::app);
+        sweep.add({"results/incr_argon2_mem.csv", (size_t) memcost * 1024, job_overhead, 4, false, [=](std::ostream &f1) {
             Argon2 alg("Argon2", 3, memcost);
             int memory_usage = alg.memoryFootprint("../resources/rockyou32.txt");
             double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
             std::cout << memcost << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
-            f1 << memcost << "," << elapsed_time << "," << memory_usage << std::endl;
-            f1.close();
-            _exit(0);
-        } else {
-            waitpid(pid, NULL, 0);
+            f1 << memcost << "," << elapsed_time << "," << memory_usage << ",";
+            alg.counters.writeCsv(f1);
+        }});
+        memcost *= 2;
+    }
+}
+
+// Computation Time (32 passwords, rockyou32.txt) on Argon2id with increasing memory cost,
+// default allocation vs a reused pre-faulted arena
+// One warmup hash per run maps the arena, so the timed hashes show only compression cost
+void test_argon2_arena() {
+    std::ofstream f("results/argon2_arena.csv");
+    f << "Computation Time (32 passwords, rockyou32.txt) on Argon2id, default allocation vs arena, " << get_hardware_string() << std::endl;
+    f << "Memcost(B),Allocation,Time(s)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
+    f.close();
+    int memcost = 65536;
+    for (int i = 0; i < 5; i++) {
+        for (bool arena : {false, true}) {
+            sweep.add({"results/argon2_arena.csv", (size_t) memcost * 1024, job_overhead, 4, true, [=](std::ostream &f1) {
+                Argon2 alg("Argon2", 3, memcost, arena);
+                alg._hash("warmup");
+                double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
+                const char *mode = arena ? "arena" : "default";
+                std::cout << memcost << " " << mode << ": " << elapsed_time << " seconds" << std::endl;
+                f1 << memcost << "," << mode << "," << elapsed_time << ",";
+                alg.counters.writeCsv(f1);
+            }});
         }
         memcost *= 2;
     }
@@ -139,21 +787,56 @@ void test_argon2_memory_param() {
 void test_argon2_time_param() {
     std::ofstream f("results/incr_argon2_time.csv");
     f << "Computation Time (32 passwords, rockyou32.txt) on Argon2id with increasing time cost, " << get_hardware_string() << std::endl;
-    f << "Timecost,Time(s),MemoryUsage(KB)" << std::endl;
+    f << "Timecost,Time(s),MemoryUsage(KB)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
     f.close();
     for (int timecost = 1; timecost < 6; timecost++) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            std::ofstream f1("results/incr_argon2_time.csv", std::ios_base::app);
+        sweep.add({"results/incr_argon2_time.csv", (size_t) 65536 * 1024, job_overhead, 4, false, [=](std::ostream &f1) {
             Argon2 alg("Argon2", timecost, 65536);
             int memory_usage = alg.memoryFootprint("../resources/rockyou32.txt");
             double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
             std::cout << timecost << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
-            f1 << timecost << "," << elapsed_time << "," << memory_usage << std::endl;
-            f1.close();
-            _exit(0);
-        } else {
-            waitpid(pid, NULL, 0);
+            f1 << timecost << "," << elapsed_time << "," << memory_usage << ",";
+            alg.counters.writeCsv(f1);
+        }});
+    }
+}
+
+// Computation Time and Memory Use (32 passwords, rockyou32.txt) on the memory-hard default algorithms
+// under every page policy
+// The host is reconfigured per run (THP mode, hugetlb pools; needs root) and restored at the end
+// yescrypt memory is mapped inside libxcrypt at the default hugepage size, so hugetlb policies of
+// another size cannot apply to it, and thp-madvise leaves its memory unadvised
+void test_page_policies() {
+    std::ofstream f("results/page_policy.csv");
+    f << "Computation Time (32 passwords, rockyou32.txt) on the memory-hard algorithms per page policy, " << get_hardware_string() << std::endl;
+    f << "Algorithm,Policy,Time(s),MemoryUsage(KB)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
+    f.close();
+    HostPageGuard host_guard;
+    size_t default_hugepage = HostPageConfig::defaultHugepageSize();
+    for (HashBenchmark *algorithm : default_algorithms) {
+        if (algorithm->memoryCost() == 0) {
+            continue;
+        }
+        for (PagePolicy policy : allPagePolicies) {
+            size_t page = policy == PAGE_HUGETLB_2M ? HUGEPAGE_2M : policy == PAGE_HUGETLB_1G ? HUGEPAGE_1G : 0;
+            // Argon2 lanes and scrypt instances all live in one hash's memory, so one hash at a time
+            // is the whole working set
+            if (!configureHost(policy, algorithm->memoryCost(), 1)) {
+                std::cout << algorithm->name << " " << pagePolicyName(policy) << ": unavailable on this host" << std::endl;
+                continue;
+            }
+            runIsolated("results/page_policy.csv", [&](std::ostream &f1) {
+                applyProcessPolicy(policy);
+                if (!algorithm->setPagePolicy(policy) && page != 0 && page != default_hugepage) {
+                    std::cout << algorithm->name << " " << pagePolicyName(policy) << ": library allocates " << default_hugepage / 1024 << " KiB hugepages only" << std::endl;
+                    return;
+                }
+                int memory_usage = algorithm->memoryFootprint("../resources/rockyou32.txt");
+                double elapsed_time = algorithm->computeTime("../resources/rockyou32.txt");
+                std::cout << algorithm->name << " " << pagePolicyName(policy) << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
+                f1 << algorithm->name << "," << pagePolicyName(policy) << "," << elapsed_time << "," << memory_usage << ",";
+                algorithm->counters.writeCsv(f1);
+            });
         }
     }
 }
@@ -162,22 +845,17 @@ void test_argon2_time_param() {
 void test_pbkdf2_iters_param() {
     std::ofstream f("results/incr_pbkdf2_iters.csv");
     f << "Computation Time (32 passwords, rockyou32.txt) on PBKDF2 with increasing iterations, " << get_hardware_string() << std::endl;
-    f << "Iters,Time(s),MemoryUsage(KB)" << std::endl;
+    f << "Iters,Time(s),MemoryUsage(KB)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
     f.close();
     for (int iters : {10000, 100000, 200000, 400000, 600000, 1000000, 2000000}) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            std::ofstream f1("results/incr_pbkdf2_iters.csv", std::ios_base::app);
+        sweep.add({"results/incr_pbkdf2_iters.csv", 0, job_overhead, 1, false, [=](std::ostream &f1) {
             Pbkdf2 alg("PBKDF2", iters);
             int memory_usage = alg.memoryFootprint("../resources/rockyou32.txt");
             double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
             std::cout << iters << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
-            f1 << iters << "," << elapsed_time << "," << memory_usage << std::endl;
-            f1.close();
-            _exit(0);
-        } else {
-            waitpid(pid, NULL, 0);
-        }
+            f1 << iters << "," << elapsed_time << "," << memory_usage << ",";
+            alg.counters.writeCsv(f1);
+        }});
     }
 }
 
@@ -185,7 +863,7 @@ void test_pbkdf2_iters_param() {
 void test_scrypt_params() {
     std::ofstream f("results/incr_scrypt.csv");
     f << "Computation Time (32 passwords, rockyou32.txt) on Scrypt with increasing parameters, " << get_hardware_string() << std::endl;
-    f << "N,R,P,Time(s),MemoryUsage(KB)" << std::endl;
+    f << "N,R,P,Time(s),MemoryUsage(KB)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
     f.close();
     std::vector<std::unordered_map<std::string, int>> confs = {
         {{"n", 1 << 17}, {"r", 8}, {"p", 1}},
@@ -193,26 +871,71 @@ void test_scrypt_params() {
         {{"n", 1 << 13}, {"r", 8}, {"p", 1}}
     };
     for (auto conf : confs) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            std::ofstream f1("results/incr_scrypt.csv", std::ios_base::app);
-            Scrypt alg("Scrypt", conf["n"], conf["r"], conf["p"]);
+        sweep.add({"results/incr_scrypt.csv", (size_t) 128 * conf.at("r") * conf.at("n"), job_overhead, 1, false, [=](std::ostream &f1) {
+            Scrypt alg("Scrypt", conf.at("n"), conf.at("r"), conf.at("p"));
             int memory_usage = alg.memoryFootprint("../resources/rockyou32.txt");
             double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
-            std::cout << conf["n"] << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
-            f1 << conf["n"] << "," << conf["r"] << "," << conf["p"] << "," << elapsed_time << "," << memory_usage << std::endl;
-            f1.close();
-            _exit(0);
-        } else {
-            pid_t pid2 = fork();
-            if (pid2 == 0) {
-                const char *const args[3] = {"python", "hugepage_scout.py", NULL};
-                execvp("python", const_cast<char *const *>(args));
-                assert(false);
-            }
-            waitpid(pid, NULL, 0);
-            kill(pid2, SIGINT);
+            std::cout << conf.at("n") << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
+            f1 << conf.at("n") << "," << conf.at("r") << "," << conf.at("p") << "," << elapsed_time << "," << memory_usage << ",";
+            alg.counters.writeCsv(f1);
+        }});
+    }
+}
+
+// Concurrency check (100 passwords, rockyou100.txt) on the crypt_ra backend, for scrypt $7$ and
+// yescrypt, and on the in-tree scrypt
+// Hashes are made on one thread, then 16 threads verify them, reject neighbours' passwords and
+// hash-and-verify afresh at the same time; any shared state in a backend shows up as a mismatch
+// Scrypt no longer calls libxcrypt itself, so its crypt-backed case rebuilds each record through
+// cryptReentrant from the setting the in-tree engine wrote, which also cross-checks the two
+void test_crypt_concurrency() {
+    const Corpus &corpus = Corpus::load("../resources/rockyou100.txt");
+    std::vector<std::string> passwords;
+    for (size_t i = 0; i < corpus.size(); i++) {
+        passwords.emplace_back(corpus[i]);
+    }
+    Scrypt scrypt("Scrypt", 1 << 10, 8, 2);
+    Yescrypt yescrypt("yescrypt", 1024);
+    struct Backend {
+        std::string name;
+        std::function<std::string(const std::string &)> hash;
+        std::function<bool(const std::string &, const std::string &)> check;
+    };
+    std::vector<Backend> backends = {{"Scrypt (crypt_ra)", [&](const std::string &password) {
+        std::string setting = scrypt._hash(password);
+        setting.resize(setting.rfind('$') + 1);
+        return cryptReentrant(password, setting.c_str());
+    }, [](const std::string &hash, const std::string &password) {
+        const char *res = threadScratch().tryCrypt(password.c_str(), hash.c_str());
+        return res != NULL && hash == res;
+    }}};
+    for (HashBenchmark *algorithm : std::vector<HashBenchmark *>{&scrypt, &yescrypt}) {
+        backends.push_back({algorithm->name, [=](const std::string &password) { return algorithm->_hash(password); },
+            [=](const std::string &hash, const std::string &password) { return algorithm->_checkHash(hash, password); }});
+    }
+    for (const Backend &backend : backends) {
+        std::vector<std::string> hashes;
+        for (const std::string &password : passwords) {
+            hashes.push_back(backend.hash(password));
+        }
+        std::atomic<int> failures(0);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 16; t++) {
+            workers.emplace_back([&, t]() {
+                for (size_t k = 0; k < passwords.size(); k++) {
+                    size_t i = (k + t * 7) % passwords.size();
+                    size_t j = (i + 1) % passwords.size();
+                    if (!backend.check(hashes[i], passwords[i])) failures++;
+                    if (passwords[i] != passwords[j] && backend.check(hashes[i], passwords[j])) failures++;
+                    if (!backend.check(backend.hash(passwords[i]), passwords[i])) failures++;
+                }
+            });
+        }
+        for (std::thread &worker : workers) {
+            worker.join();
         }
+        std::cout << backend.name << " concurrency: " << failures << " failures" << std::endl;
+        assert(failures == 0);
     }
 }
 
@@ -220,34 +943,221 @@ void test_scrypt_params() {
 void test_yescrypt_params() {
     std::ofstream f("results/incr_yescrypt.csv");
     f << "Computation Time (32 passwords, rockyou32.txt) on Yescrypt with increasing parameters, " << get_hardware_string() << std::endl;
-    f << "N,Time(s),MemoryUsage(KB)" << std::endl;
+    f << "N,Time(s),MemoryUsage(KB)," << PerfCounts::csvHeader() << "," << CgroupUsage::csvHeader() << std::endl;
     f.close();
     for (int n : {4096, 8192, 16384, 32768, 65536}) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            std::ofstream f1("results/incr_yescrypt.csv", std::ios_base::app);
+        sweep.add({"results/incr_yescrypt.csv", (size_t) 128 * 32 * n, job_overhead, 1, false, [=](std::ostream &f1) {
             Yescrypt alg("yescrypt", n);
             int memory_usage = alg.memoryFootprint("../resources/rockyou32.txt");
             double elapsed_time = alg.computeTime("../resources/rockyou32.txt");
             std::cout << n << ": " << elapsed_time << " seconds, " << memory_usage << " KB" << std::endl;
-            f1 << n << "," << elapsed_time << "," << memory_usage << std::endl;
-            f1.close();
-            _exit(0);
-        } else {
-            pid_t pid2 = fork();
-            if (pid2 == 0) {
-                const char *const args[3] = {"python", "hugepage_scout.py", NULL};
-                execvp("python", const_cast<char *const *>(args));
-                assert(false);
+            f1 << n << "," << elapsed_time << "," << memory_usage << ",";
+            alg.counters.writeCsv(f1);
+        }});
+    }
+}
+
+// Yescrypt (N = 4096, r = 32) with a shared ROM: built once on every core, then read by every hashing thread
+// The in-tree yescrypt is first checked against libxcrypt, and ROM hashes against the ROM they were made with
+// Per ROM size: init time and the ROM's page policy, per-hash latency one at a time and on all cores, throughput
+// ROMs go on 2 MiB hugetlb pages if the host can be configured for them, else on THP; sizes over half the
+// memory available now are skipped
+void test_yescrypt_rom() {
+    const Corpus &passwords = Corpus::load("../resources/rockyou32.txt");
+    for (int n : {1024, 4096}) {
+        Yescrypt library("yescrypt", n);
+        Yescrypt native("yescrypt", n, nullptr);
+        for (size_t i = 0; i < 8; i++) {
+            std::string password(passwords[i]);
+            std::string hash = library._hash(password);
+            assert(native._checkHash(hash, password) && !native._checkHash(hash, password + "x"));
+            hash = native._hash(password);
+            assert(hash == cryptReentrant(password, hash.c_str()));
+        }
+    }
+
+    // 32 MiB ROMs: one saved and loaded back both ways, one from another seed
+    const uint64_t blocks = 1 << 13;
+    const char *path = "results/yescrypt.rom";
+    std::shared_ptr<const yescrypt_core::Rom> built = yescrypt_core::Rom::build("hashbench ROM", blocks, 32, 2, 2, PAGE_DEFAULT);
+    std::shared_ptr<const yescrypt_core::Rom> other = yescrypt_core::Rom::build("another ROM", blocks, 32, 2, 2, PAGE_DEFAULT);
+    assert(built != nullptr && other != nullptr && built->save(path));
+    std::shared_ptr<const yescrypt_core::Rom> mapped = yescrypt_core::Rom::load(path, blocks, 32, PAGE_DEFAULT);
+    std::shared_ptr<const yescrypt_core::Rom> copied = yescrypt_core::Rom::load(path, blocks, 32, PAGE_THP_MADVISE);
+    assert(mapped != nullptr && copied != nullptr && yescrypt_core::Rom::load(path, blocks * 2, 32, PAGE_DEFAULT) == nullptr);
+    unlink(path);
+    Yescrypt withRom("yescrypt-ROM", 4096, built), withMapped("yescrypt-ROM", 4096, mapped), withCopied("yescrypt-ROM", 4096, copied);
+    Yescrypt withOther("yescrypt-ROM", 4096, other), withoutRom("yescrypt", 4096, nullptr);
+    for (size_t i = 0; i < 4; i++) {
+        std::string password(passwords[i]);
+        std::string hash = withRom._hash(password);
+        char phc[PHC_MAX_LENGTH];
+        assert(withRom.phcHash(password, phc) > 0);
+        assert(withMapped._checkHash(hash, password) && withCopied._checkHash(hash, password) && withMapped.phcVerify(phc, password));
+        assert(!withRom._checkHash(hash, password + "x") && !withOther._checkHash(hash, password) && !withOther.phcVerify(phc, password));
+        assert(!withoutRom._checkHash(hash, password) && !withoutRom.phcVerify(phc, password));
+    }
+
+    std::ofstream f("results/yescrypt_rom.csv");
+    f << "Yescrypt (N = 4096, r = 32, 32 passwords per thread, rockyou32.txt) with a shared ROM per ROM size, " << get_hardware_string() << std::endl;
+    f << "ROM(MiB),Policy,Init(s),Threads,P50(ms),P99(ms),Throughput(hash/s)" << std::endl;
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> concurrency = {1};
+    if (cores > 1) {
+        concurrency.push_back(cores);
+    }
+    HostPageGuard host_guard;
+    size_t available = SweepScheduler::availableMemory();
+    // 0 for no ROM, then 64 MiB to 4 GiB of 4 KiB blocks
+    for (int romLog : {0, 14, 16, 18, 19, 20}) {
+        size_t romBytes = romLog != 0 ? (size_t) 128 * 32 << romLog : 0;
+        if (romBytes > available / 2) {
+            std::cout << "yescrypt ROM " << (romBytes >> 20) << " MiB: over half the available memory" << std::endl;
+            continue;
+        }
+        std::shared_ptr<const yescrypt_core::Rom> rom;
+        PagePolicy policy = PAGE_DEFAULT;
+        double init_time = 0;
+        if (romLog != 0) {
+            policy = configureHost(PAGE_HUGETLB_2M, romBytes, 1) ? PAGE_HUGETLB_2M : PAGE_THP_MADVISE;
+            auto start = std::chrono::steady_clock::now();
+            rom = yescrypt_core::Rom::build("hashbench ROM", (uint64_t) 1 << romLog, 32, cores, cores, policy);
+            if (rom == nullptr && policy != PAGE_THP_MADVISE) {
+                policy = PAGE_THP_MADVISE;
+                start = std::chrono::steady_clock::now();
+                rom = yescrypt_core::Rom::build("hashbench ROM", (uint64_t) 1 << romLog, 32, cores, cores, policy);
             }
-            waitpid(pid, NULL, 0);
-            kill(pid2, SIGINT);
+            init_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            assert(rom != nullptr);
+        }
+        Yescrypt alg("yescrypt-ROM", 4096, rom);
+        for (unsigned int threads : concurrency) {
+            std::vector<LatencyHistogram> latencies(threads);
+            std::vector<std::thread> workers;
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    for (size_t i = 0; i < passwords.size(); i++) {
+                        auto begin = std::chrono::steady_clock::now();
+                        std::string hash = alg._hash(std::string(passwords[i]));
+                        latencies[t].record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+                        assert(!hash.empty());
+                    }
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            double elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            for (unsigned int t = 1; t < threads; t++) {
+                latencies[0].merge(latencies[t]);
+            }
+            double p50 = latencies[0].percentile(0.5) * 1e-6, p99 = latencies[0].percentile(0.99) * 1e-6;
+            double throughput = latencies[0].count() / elapsed_time;
+            std::cout << "yescrypt ROM " << (romBytes >> 20) << " MiB " << pagePolicyName(policy) << " init " << init_time << " s, threads="
+                      << threads << ": p50 " << p50 << " ms, p99 " << p99 << " ms, " << throughput << " hash/s" << std::endl;
+            f << (romBytes >> 20) << "," << pagePolicyName(policy) << "," << init_time << "," << threads << ","
+              << p50 << "," << p99 << "," << throughput << std::endl;
         }
     }
+    f.close();
+}
+
+// Onion migration of a credential file (rockyou1k.txt users) with legacy SHA-256 and PBKDF2 records, to Argon2
+// First checks an interrupted run resumes from its checkpoint and every migrated record verifies;
+// then times whole runs on one thread and on all cores and projects hours for 10M and 50M users
+// The outer Argon2 has one lane per hash, since the pool already keeps every core busy
+void test_migration() {
+    const Corpus &passwords = Corpus::load("../resources/rockyou1k.txt");
+    const std::string input_file = "results/migrate_in.txt", output_file = "results/migrate_out.txt";
+    Sha256 sha256("SHA256");
+    Pbkdf2 pbkdf2("PBKDF2", 1000);
+    char phc[PHC_MAX_LENGTH];
+    std::ofstream in(input_file);
+    for (size_t i = 0; i < passwords.size(); i++) {
+        std::string password(passwords[i]);
+        in << "user" << i << ":";
+        switch (i % 5) {
+            case 0: in << sha256._hash(password); break;
+            case 1: in << pbkdf2._hash(password); break;
+            case 2: sha256.phcHash(password, phc); in << phc; break;
+            case 3: pbkdf2.phcHash(password, phc); in << phc; break;
+            case 4: in << "!locked"; break;
+        }
+        in << "\n";
+    }
+    in.close();
+    std::vector<HashBenchmark *> legacy = {&sha256, &pbkdf2};
+
+    Argon2 outer("Argon2-migrate", 2, 16384, 1, true);
+    unsigned int max_threads = std::thread::hardware_concurrency();
+    Migration migration(outer, input_file, output_file);
+    migration.legacyIterations = 1000;
+    migration.batchSize = 32;
+    migration.checkpointEvery = 2;
+    migration.reset();
+    MigrationResult first = migration.run(max_threads, 300);
+    MigrationResult second = migration.run(max_threads);
+    assert(first.records == 300 && second.resumedAt == 300 && first.records + second.records == passwords.size());
+    assert(first.passedThrough + second.passedThrough == passwords.size() / 5);
+    assert(migration.run(max_threads).records == 0);
+    std::ifstream out(output_file);
+    std::string line;
+    size_t count = 0;
+    for (; std::getline(out, line); count++) {
+        std::string user = "user" + std::to_string(count) + ":";
+        assert(line.compare(0, user.size(), user) == 0);
+        std::string_view stored = std::string_view(line).substr(user.size());
+        if (count % 5 == 4) {
+            assert(stored == "!locked");
+            continue;
+        }
+        assert(Migration::verify(stored, passwords[count], outer, legacy));
+        assert(!Migration::verify(stored, "not the password", outer, legacy));
+    }
+    assert(count == passwords.size());
+    out.close();
+
+    std::ofstream f("results/migration.csv");
+    f << "Onion migration (rockyou1k.txt users, 4/5 legacy SHA-256 and PBKDF2) to Argon2id t=2 m=16MiB p=1, " << get_hardware_string() << std::endl;
+    f << "Outer,BatchSize,MaxBatches," << MigrationResult::csvHeader() << ",Hours(10M),Hours(50M)" << std::endl;
+    for (bool arena : {false, true}) {
+        Argon2 alg(arena ? "Argon2-migrate-arena" : "Argon2-migrate", 2, 16384, 1, arena);
+        Migration timed(alg, input_file, output_file);
+        timed.legacyIterations = 1000;
+        for (unsigned int threads : {1u, max_threads}) {
+            timed.reset();
+            MigrationResult result = timed.run(threads);
+            assert(result.records == passwords.size());
+            double hours_10m = result.projectedSeconds(10000000) / 3600, hours_50m = result.projectedSeconds(50000000) / 3600;
+            std::cout << alg.name << " x" << result.threads << ": " << result.recordsPerSecond() << " records/s, "
+                      << hours_10m << " h for 10M users" << std::endl;
+            f << alg.name << "," << timed.batchSize << "," << 4 * result.threads << ",";
+            result.writeCsv(f);
+            f << "," << hours_10m << "," << hours_50m << std::endl;
+            if (max_threads == 1) {
+                break;
+            }
+        }
+    }
+    f.close();
+    migration.reset();
+    std::remove(input_file.c_str());
+    std::remove(output_file.c_str());
 }
 
 int main() {
     initialize(default_algorithms);
+    writeHostFingerprint();
+
+    // Salts come from a buffered getrandom pool; a fixed seed makes runs reproducible
+    // SaltProvider::setMode(SALT_SEEDED, 1337);
+
+    // Statistical tests run 1 warmup pass then 5 timed ones
+    // harness_config.repetitions = 10;
+
+    // Hardware counter columns stay empty unless instrumentation is on
+    // PerfGroup::enabled = true;
     
     // Default configuration memory test
     memoryUseTest1();
@@ -255,13 +1165,33 @@ int main() {
     // // Paramter-based time and memory tests
     test_argon2_memory_param();
     test_argon2_time_param();
+    test_argon2_arena();
+    test_page_policies();
     test_pbkdf2_iters_param();
     test_scrypt_params();
     test_yescrypt_params();
+    test_crypt_concurrency();
+    sweep.run();
 
     // // Computation time only tests
     // // Must be run after all other tests or on their own
     computationTimeTest1();
     computationTimeTest2();
+    computationTimeTest3();
+    computationTimeTest4();
+    computationTimeTest5();
+    computationTimeTest6();
+    computationTimeTest7();
+    test_yescrypt_rom();
+    test_phc_verify();
+    bruteForceTest1();
+    test_dictionary_attack();
+    test_migration();
+    test_salt_providers();
+    scalingTest1();
+    scalingTest2();
+    test_latency_histograms();
+    test_login_load();
+    test_parameter_tuner();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,350 @@
+#ifndef MIGRATE_HPP
+#define MIGRATE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <fstream>
+#include <ostream>
+#include <cstdio>
+#include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
+#include "framework.hpp"
+
+// Numbers for one run of a credential file through the migration
+struct MigrationResult {
+    size_t resumedAt = 0;    // Records a checkpoint said were already done
+    size_t records = 0;      // Records read this run
+    size_t migrated = 0;
+    size_t passedThrough = 0;  // Already migrated, or not a hash the migration knows
+    unsigned int threads = 0;
+    size_t checkpoints = 0;
+    Sample time;
+
+    double recordsPerSecond() const {
+        return records / time.wall;
+    }
+
+    // Wall time the same host would take for users records at this run's rate
+    double projectedSeconds(size_t users) const {
+        return records ? users / recordsPerSecond() : 0;
+    }
+
+    static const char *csvHeader() {
+        return "ResumedAt,Records,Migrated,PassedThrough,Threads,Checkpoints,Time(s),ProcessCpu(s),Records/s";
+    }
+
+    void writeCsv(std::ostream &f) const {
+        f << resumedAt << "," << records << "," << migrated << "," << passedThrough << "," << threads << ","
+          << checkpoints << "," << time.wall << "," << time.processCpu << "," << recordsPerSecond();
+    }
+};
+
+// Onion rehash of a credential file: every stored legacy digest becomes the password of a stronger
+// KDF, so accounts upgrade without their passwords
+// Input lines are <user>:<stored>, stored being a PHC string, a Sha256 record (hex digest) or a Pbkdf2
+// record (hex salt $ hex digest, at legacyIterations); output lines are <user>:<outer PHC>:<inner setting>
+// where the outer KDF hashed the hex of the legacy digest and the inner setting is the legacy PHC string
+// without its digest, plus l=<digest length>. Anything else is copied through unchanged
+// The file streams through in batches: the calling thread reads, a pool hashes, a writer keeps input
+// order. At most maxBatches are held at once, so memory does not grow with the file. After every
+// checkpointEvery batches the output is synced and <output>.ckpt records how far both files are done;
+// a later run resumes from there
+class Migration {
+    private:
+        struct Batch {
+            size_t sequence = 0;
+            uint64_t inputEnd = 0;  // Input offset just past the batch's last line
+            std::vector<std::string> lines;
+            std::string out;
+            size_t migrated = 0;
+        };
+
+        struct Checkpoint {
+            uint64_t inputOffset = 0;
+            uint64_t outputOffset = 0;
+            size_t records = 0;
+        };
+
+        HashBenchmark &outer;
+        std::string inputPath;
+        std::string outputPath;
+        std::string checkpointPath;
+
+        // Legacy stored hash to the PHC record of its inner KDF, digest included
+        bool legacyRecord(std::string_view stored, PhcRecord &rec) const {
+            if (stored.size() == 64 && unhex(stored, rec.hash)) {
+                strcpy(rec.id, "sha256");
+                rec.hasVersion = false;
+                rec.paramCount = rec.saltLen = 0;
+                rec.hashLen = 32;
+                return true;
+            }
+            if (stored.size() == 97 && stored[32] == '$' && unhex(stored.substr(0, 32), rec.salt) && unhex(stored.substr(33), rec.hash)) {
+                strcpy(rec.id, "pbkdf2-sha256");
+                rec.hasVersion = false;
+                rec.paramCount = 0;
+                rec.addParam("i", legacyIterations);
+                rec.saltLen = 16;
+                rec.hashLen = 32;
+                return true;
+            }
+            return stored.find(':') == std::string_view::npos && phc::decode(stored, rec) && rec.hashLen > 0;
+        }
+
+        static bool unhex(std::string_view hex, uint8_t *out) {
+            auto nibble = [](char c) {
+                return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            };
+            for (size_t i = 0; i < hex.size() / 2; i++) {
+                int hi = nibble(hex[2 * i]), lo = nibble(hex[2 * i + 1]);
+                if (hi < 0 || lo < 0) {
+                    return false;
+                }
+                out[i] = (uint8_t) (hi << 4 | lo);
+            }
+            return true;
+        }
+
+        static void hexDigest(const uint8_t *digest, size_t len, char *out) {
+            static const char *hexmap = "0123456789abcdef";
+            for (size_t i = 0; i < len; i++) {
+                out[2 * i] = hexmap[digest[i] >> 4];
+                out[2 * i + 1] = hexmap[digest[i] & 0xf];
+            }
+        }
+
+        // Append the migrated form of one input line to out; false if it was copied through
+        bool migrateLine(const std::string &line, std::string &out) {
+            size_t colon = line.find(':');
+            PhcRecord rec;
+            if (colon == std::string::npos || !legacyRecord(std::string_view(line).substr(colon + 1), rec)) {
+                out += line;
+                out += '\n';
+                return false;
+            }
+            char password[2 * PhcRecord::maxHash];
+            hexDigest(rec.hash, rec.hashLen, password);
+            char phc[PHC_MAX_LENGTH];
+            size_t phcLen = outer.phcHash(std::string_view(password, 2 * rec.hashLen), phc);
+            assert(phcLen > 0);
+            // The digest's length stays, the digest itself does not
+            size_t hashLen = rec.hashLen;
+            rec.hashLen = 0;
+            char setting[PHC_MAX_LENGTH];
+            size_t settingLen = rec.addParam("l", hashLen) ? phc::encode(rec, setting, sizeof(setting)) : 0;
+            if (settingLen == 0) {
+                out += line;
+                out += '\n';
+                return false;
+            }
+            out.append(line, 0, colon + 1);
+            out.append(phc, phcLen);
+            out += ':';
+            out.append(setting, settingLen);
+            out += '\n';
+            return true;
+        }
+
+        bool readCheckpoint(Checkpoint &ckpt) const {
+            std::ifstream file(checkpointPath);
+            return (bool) (file >> ckpt.inputOffset >> ckpt.outputOffset >> ckpt.records);
+        }
+
+        // Written aside and renamed over the old one, so a crash leaves one or the other
+        void writeCheckpoint(const Checkpoint &ckpt) const {
+            std::string tmp = checkpointPath + ".tmp";
+            FILE *file = fopen(tmp.c_str(), "w");
+            assert(file != NULL);
+            fprintf(file, "%lu %lu %zu\n", (unsigned long) ckpt.inputOffset, (unsigned long) ckpt.outputOffset, ckpt.records);
+            fflush(file);
+            fdatasync(fileno(file));
+            fclose(file);
+            assert(rename(tmp.c_str(), checkpointPath.c_str()) == 0);
+        }
+
+    public:
+        size_t batchSize = 256;       // Records per unit of work
+        size_t maxBatches = 0;        // Batches held at once; 0 for four per thread
+        size_t checkpointEvery = 16;  // Batches between checkpoints
+        uint64_t legacyIterations = 600000;  // Pbkdf2 records do not store their iterations
+
+        Migration(HashBenchmark &outer, const std::string &inputPath, const std::string &outputPath)
+            : outer(outer), inputPath(inputPath), outputPath(outputPath), checkpointPath(outputPath + ".ckpt") {}
+
+        // Forget any earlier progress; the next run starts over
+        void reset() {
+            std::remove(checkpointPath.c_str());
+        }
+
+        // Migrate up to maxRecords more records, all of the rest if 0, on a pool of threads
+        // Picks up after the last checkpoint, whose output is kept and anything past it dropped;
+        // non-reentrant outer algorithms always run on one thread
+        MigrationResult run(unsigned int threads, size_t maxRecords = 0) {
+            if (!outer.reentrant()) {
+                threads = 1;
+            }
+            size_t limit = maxBatches ? maxBatches : 4 * threads;
+            Checkpoint ckpt;
+            bool resume = readCheckpoint(ckpt);
+            if (!resume) {
+                ckpt = Checkpoint();
+            }
+            std::ifstream input(inputPath, std::ios::binary);
+            assert(input.is_open());
+            input.seekg(ckpt.inputOffset);
+            int output = open(outputPath.c_str(), O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC), 0644);
+            assert(output >= 0);
+            assert(lseek(output, 0, SEEK_END) >= (off_t) ckpt.outputOffset);
+            assert(ftruncate(output, ckpt.outputOffset) == 0 && lseek(output, ckpt.outputOffset, SEEK_SET) == (off_t) ckpt.outputOffset);
+
+            MigrationResult result;
+            result.resumedAt = ckpt.records;
+            result.threads = threads;
+
+            std::mutex lock;
+            std::condition_variable changed;
+            std::deque<std::unique_ptr<Batch>> queued;           // Read, not yet claimed by a worker
+            std::map<size_t, std::unique_ptr<Batch>> finished;   // Hashed, waiting for their turn to be written
+            size_t held = 0;
+            bool reading = true;
+
+            Stopwatch watch;
+            watch.start();
+            std::vector<std::thread> workers;
+            for (unsigned int t = 0; t < threads; t++) {
+                workers.emplace_back([&]() {
+                    while (true) {
+                        std::unique_ptr<Batch> batch;
+                        {
+                            std::unique_lock<std::mutex> guard(lock);
+                            changed.wait(guard, [&]() { return !queued.empty() || !reading; });
+                            if (queued.empty()) {
+                                return;
+                            }
+                            batch = std::move(queued.front());
+                            queued.pop_front();
+                        }
+                        for (const std::string &line : batch->lines) {
+                            batch->migrated += migrateLine(line, batch->out);
+                        }
+                        std::lock_guard<std::mutex> guard(lock);
+                        finished.emplace(batch->sequence, std::move(batch));
+                        changed.notify_all();
+                    }
+                });
+            }
+
+            // Written in input order; a checkpoint only ever covers a prefix of both files
+            std::thread writer([&]() {
+                size_t next = 0, sinceCheckpoint = 0;
+                while (true) {
+                    std::unique_ptr<Batch> batch;
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        changed.wait(guard, [&]() { return finished.count(next) || (!reading && held == 0); });
+                        if (!finished.count(next)) {
+                            break;
+                        }
+                        batch = std::move(finished[next]);
+                        finished.erase(next);
+                    }
+                    for (size_t done = 0; done < batch->out.size(); ) {
+                        ssize_t n = write(output, batch->out.data() + done, batch->out.size() - done);
+                        assert(n > 0);
+                        done += n;
+                    }
+                    ckpt.inputOffset = batch->inputEnd;
+                    ckpt.outputOffset += batch->out.size();
+                    ckpt.records += batch->lines.size();
+                    result.migrated += batch->migrated;
+                    result.passedThrough += batch->lines.size() - batch->migrated;
+                    if (++sinceCheckpoint == checkpointEvery) {
+                        fdatasync(output);
+                        writeCheckpoint(ckpt);
+                        result.checkpoints++;
+                        sinceCheckpoint = 0;
+                    }
+                    next++;
+                    std::lock_guard<std::mutex> guard(lock);
+                    held--;
+                    changed.notify_all();
+                }
+            });
+
+            // The reader blocks while limit batches are out, which is what bounds memory
+            uint64_t offset = ckpt.inputOffset;
+            std::string line;
+            for (size_t sequence = 0; !maxRecords || result.records < maxRecords; sequence++) {
+                std::unique_ptr<Batch> batch(new Batch());
+                batch->sequence = sequence;
+                size_t want = maxRecords ? std::min(batchSize, maxRecords - result.records) : batchSize;
+                while (batch->lines.size() < want && std::getline(input, line)) {
+                    offset += line.size() + !input.eof();
+                    if (!line.empty()) {
+                        batch->lines.push_back(line);
+                    }
+                }
+                batch->inputEnd = offset;
+                if (batch->lines.empty()) {
+                    break;
+                }
+                result.records += batch->lines.size();
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return held < limit; });
+                held++;
+                queued.push_back(std::move(batch));
+                changed.notify_all();
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                reading = false;
+                changed.notify_all();
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            writer.join();
+            fdatasync(output);
+            close(output);
+            writeCheckpoint(ckpt);
+            result.checkpoints++;
+            result.time = watch.stop();
+            return result;
+        }
+
+        // Check a password against a migrated record, <outer PHC>:<inner setting>; inner holds the
+        // legacy algorithms, tried in turn until one derives the setting
+        static bool verify(std::string_view stored, std::string_view password, HashBenchmark &outer, const std::vector<HashBenchmark *> &inner) {
+            size_t colon = stored.find(':');
+            PhcRecord rec;
+            uint64_t hashLen;
+            if (colon == std::string_view::npos || !phc::decode(stored.substr(colon + 1), rec) || rec.paramCount == 0
+                    || strcmp(rec.params[rec.paramCount - 1].name, "l") != 0) {
+                return false;
+            }
+            hashLen = rec.params[--rec.paramCount].value;
+            if (hashLen == 0 || hashLen > PhcRecord::maxHash) {
+                return false;
+            }
+            rec.hashLen = hashLen;
+            uint8_t digest[PhcRecord::maxHash];
+            char hex[2 * PhcRecord::maxHash];
+            for (HashBenchmark *legacy : inner) {
+                if (legacy->phcDerive(rec, password, digest)) {
+                    hexDigest(digest, hashLen, hex);
+                    return outer.phcVerify(stored.substr(0, colon), std::string_view(hex, 2 * hashLen));
+                }
+            }
+            return false;
+        }
+};
+
+#endif // MIGRATE_HPP
@@ -0,0 +1,326 @@
+#ifndef PAGEPOLICY_HPP
+#define PAGEPOLICY_HPP
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+// How the memory of memory-hard hashes is backed
+// PAGE_DEFAULT leaves everything as the host and the libraries already do it
+enum PagePolicy { PAGE_DEFAULT, PAGE_4K, PAGE_THP_MADVISE, PAGE_THP_ALWAYS, PAGE_HUGETLB_2M, PAGE_HUGETLB_1G };
+static const PagePolicy allPagePolicies[] = {PAGE_4K, PAGE_THP_MADVISE, PAGE_THP_ALWAYS, PAGE_HUGETLB_2M, PAGE_HUGETLB_1G};
+
+static const size_t HUGEPAGE_2M = (size_t) 1 << 21;
+static const size_t HUGEPAGE_1G = (size_t) 1 << 30;
+
+inline const char *pagePolicyName(PagePolicy policy) {
+    switch (policy) {
+        case PAGE_DEFAULT: return "default";
+        case PAGE_4K: return "4k";
+        case PAGE_THP_MADVISE: return "thp-madvise";
+        case PAGE_THP_ALWAYS: return "thp-always";
+        case PAGE_HUGETLB_2M: return "hugetlb-2m";
+        case PAGE_HUGETLB_1G: return "hugetlb-1g";
+    }
+    return "unknown";
+}
+
+// Length actually mapped for a request of bytes under the policy
+inline size_t pageMappedSize(size_t bytes, PagePolicy policy) {
+    size_t align = policy == PAGE_HUGETLB_1G ? HUGEPAGE_1G : policy == PAGE_HUGETLB_2M ? HUGEPAGE_2M : 4096;
+    return (bytes + align - 1) / align * align;
+}
+
+// Map anonymous read/write memory backed as the policy asks
+// Returns MAP_FAILED when it cannot be honoured, e.g. an empty hugetlb pool; there is no silent fallback
+inline void *mapPages(size_t bytes, PagePolicy policy) {
+    size_t size = pageMappedSize(bytes, policy);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (policy == PAGE_HUGETLB_2M) {
+        return mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    }
+    if (policy == PAGE_HUGETLB_1G) {
+        return mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+    }
+    if (policy == PAGE_DEFAULT || policy == PAGE_4K) {
+        void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (mem != MAP_FAILED && policy == PAGE_4K) {
+            madvise(mem, size, MADV_NOHUGEPAGE);
+        }
+        return mem;
+    }
+
+    // THP can only back 2 MiB-aligned ranges, so over-map and trim to an aligned start
+    char *raw = (char *) mmap(NULL, size + HUGEPAGE_2M, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (raw == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    char *mem = (char *) (((uintptr_t) raw + HUGEPAGE_2M - 1) & ~(uintptr_t) (HUGEPAGE_2M - 1));
+    if (mem != raw) {
+        munmap(raw, mem - raw);
+    }
+    munmap(mem + size, raw + HUGEPAGE_2M - mem);
+    if (policy == PAGE_THP_MADVISE) {
+        madvise(mem, size, MADV_HUGEPAGE);
+    }
+    return mem;
+}
+
+inline void unmapPages(void *mem, size_t bytes, PagePolicy policy) {
+    munmap(mem, pageMappedSize(bytes, policy));
+}
+
+// Working memory that is mapped and touched once, then reused by every hash on one thread
+struct PageArena {
+    uint8_t *memory = NULL;
+    size_t size = 0;
+    PagePolicy policy = PAGE_DEFAULT;
+
+    ~PageArena() {
+        release();
+    }
+
+    // At least bytes backed as the policy asks, remapped only when that grows or the policy changes;
+    // every page is faulted in on mapping so no hash ever pays for it. NULL if it cannot be mapped
+    uint8_t *reserve(size_t bytes, PagePolicy policy) {
+        if (memory != NULL && size >= bytes && this->policy == policy) {
+            return memory;
+        }
+        release();
+        void *mem = mapPages(bytes, policy);
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+        memset(mem, 0, bytes);
+        memory = (uint8_t *) mem;
+        size = bytes;
+        this->policy = policy;
+        return memory;
+    }
+
+    void release() {
+        if (memory != NULL) {
+            unmapPages(memory, size, policy);
+            memory = NULL;
+            size = 0;
+        }
+    }
+};
+
+// Host-wide knobs the policies depend on
+// libxcrypt maps yescrypt memory itself, trying MAP_HUGETLB at the default hugepage size before
+// plain pages, so for its yescrypt only these knobs decide the backing; the in-tree yescrypt
+// and its ROMs map through mapPages like everything else
+class HostPageConfig {
+    friend class HostPageGuard;
+    private:
+        static std::string readLine(const std::string &path) {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+
+        static bool writeLine(const std::string &path, const std::string &value) {
+            std::ofstream file(path);
+            file << value << std::endl;
+            file.close();
+            return !file.fail();
+        }
+
+        static std::string poolPath(size_t pageSize) {
+            return "/sys/kernel/mm/hugepages/hugepages-" + std::to_string(pageSize / 1024) + "kB/nr_hugepages";
+        }
+
+    public:
+        std::string thpMode;  // always, madvise or never
+        long pages2M = 0;
+        long pages1G = 0;
+
+        static HostPageConfig read() {
+            HostPageConfig config;
+            // The active mode is the bracketed one, e.g. "always [madvise] never"
+            std::string modes = readLine("/sys/kernel/mm/transparent_hugepage/enabled");
+            size_t open = modes.find('['), close = modes.find(']');
+            if (open != std::string::npos && close != std::string::npos) {
+                config.thpMode = modes.substr(open + 1, close - open - 1);
+            }
+            config.pages2M = atol(readLine(poolPath(HUGEPAGE_2M)).c_str());
+            config.pages1G = atol(readLine(poolPath(HUGEPAGE_1G)).c_str());
+            return config;
+        }
+
+        // Needs root; the kernel may grant smaller pools than asked, so re-read to check
+        bool write() const {
+            bool ok = true;
+            if (!thpMode.empty()) {
+                ok &= writeLine("/sys/kernel/mm/transparent_hugepage/enabled", thpMode);
+            }
+            ok &= writeLine(poolPath(HUGEPAGE_2M), std::to_string(pages2M));
+            ok &= writeLine(poolPath(HUGEPAGE_1G), std::to_string(pages1G));
+            return ok;
+        }
+
+        // Default hugepage size, the one MAP_HUGETLB without a size flag uses
+        static size_t defaultHugepageSize() {
+            std::ifstream meminfo("/proc/meminfo");
+            std::string key;
+            size_t value;
+            while (meminfo >> key >> value) {
+                if (key == "Hugepagesize:") {
+                    return value * 1024;
+                }
+                meminfo.ignore(256, '\n');
+            }
+            return HUGEPAGE_2M;
+        }
+};
+
+// Puts the host knobs back as they were when it was constructed: on scope exit, on exit(), and on
+// fatal signals, an assert abort included, so a run that reconfigures the host as root cannot
+// leave it that way. The restore path only uses open/write/close so it is safe in a handler.
+// Forked measuring children inherit the handlers but only the constructing process restores.
+// One guard at a time
+class HostPageGuard {
+    private:
+        struct Knob {
+            char path[96];
+            char value[32];
+        };
+        static constexpr int fatalSignals[] = {SIGHUP, SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGBUS, SIGFPE, SIGSEGV, SIGTERM};
+        static constexpr int signalCount = sizeof(fatalSignals) / sizeof(fatalSignals[0]);
+        inline static Knob knobs[3];
+        inline static int knobCount = 0;
+        inline static pid_t owner = 0;
+        inline static volatile sig_atomic_t armed = 0;
+        inline static struct sigaction previous[signalCount];
+        inline static bool installed = false;
+
+        static void add(const std::string &path, const std::string &value) {
+            Knob &knob = knobs[knobCount++];
+            snprintf(knob.path, sizeof(knob.path), "%s", path.c_str());
+            snprintf(knob.value, sizeof(knob.value), "%s\n", value.c_str());
+        }
+
+        static void restore() {
+            if (!armed || getpid() != owner) {
+                return;
+            }
+            armed = 0;
+            for (int i = 0; i < knobCount; i++) {
+                int fd = open(knobs[i].path, O_WRONLY);
+                if (fd >= 0) {
+                    ssize_t written = write(fd, knobs[i].value, strlen(knobs[i].value));
+                    (void) written;
+                    close(fd);
+                }
+            }
+        }
+
+        // Restore, then hand the signal to whatever was installed before so it still terminates
+        static void onSignal(int sig) {
+            restore();
+            for (int i = 0; i < signalCount; i++) {
+                if (fatalSignals[i] == sig) {
+                    sigaction(sig, &previous[i], NULL);
+                }
+            }
+            raise(sig);
+        }
+
+        static void onExit() {
+            restore();
+        }
+
+    public:
+        HostPageGuard() {
+            HostPageConfig original = HostPageConfig::read();
+            knobCount = 0;
+            if (!original.thpMode.empty()) {
+                add("/sys/kernel/mm/transparent_hugepage/enabled", original.thpMode);
+            }
+            add(HostPageConfig::poolPath(HUGEPAGE_2M), std::to_string(original.pages2M));
+            add(HostPageConfig::poolPath(HUGEPAGE_1G), std::to_string(original.pages1G));
+            owner = getpid();
+            armed = 1;
+            if (!installed) {
+                installed = true;
+                atexit(onExit);
+                struct sigaction action = {};
+                action.sa_handler = onSignal;
+                sigemptyset(&action.sa_mask);
+                for (int i = 0; i < signalCount; i++) {
+                    sigaction(fatalSignals[i], &action, &previous[i]);
+                }
+            }
+        }
+
+        ~HostPageGuard() {
+            restore();
+        }
+
+        HostPageGuard(const HostPageGuard &) = delete;
+        HostPageGuard &operator=(const HostPageGuard &) = delete;
+};
+
+// Bring the host in line with a policy for hashes needing bytes each, count at a time
+// Transparent policies empty the hugetlb pools so library allocations cannot land there;
+// hugetlb policies size the pool for the working set
+// Returns false if the host could not be put in that state (usually: not root)
+inline bool configureHost(PagePolicy policy, size_t bytes, size_t count) {
+    HostPageConfig want = HostPageConfig::read();
+    switch (policy) {
+        case PAGE_DEFAULT:
+            return true;
+        case PAGE_4K:
+            want.pages2M = want.pages1G = 0;
+            break;
+        case PAGE_THP_MADVISE:
+            want.thpMode = "madvise";
+            want.pages2M = want.pages1G = 0;
+            break;
+        case PAGE_THP_ALWAYS:
+            want.thpMode = "always";
+            want.pages2M = want.pages1G = 0;
+            break;
+        // One spare page per hash for the scratch libraries map next to the main array
+        case PAGE_HUGETLB_2M:
+            want.pages2M = count * (pageMappedSize(bytes, policy) / HUGEPAGE_2M + 1);
+            want.pages1G = 0;
+            break;
+        case PAGE_HUGETLB_1G:
+            want.pages1G = count * (pageMappedSize(bytes, policy) / HUGEPAGE_1G + 1);
+            want.pages2M = 0;
+            break;
+    }
+    want.write();
+    HostPageConfig got = HostPageConfig::read();
+    return got.thpMode == want.thpMode && got.pages2M >= want.pages2M && got.pages1G >= want.pages1G
+        && (want.pages2M != 0 || got.pages2M == 0) && (want.pages1G != 0 || got.pages1G == 0);
+}
+
+// Process-wide part of a policy, applied in the measuring process before any hashing
+inline void applyProcessPolicy(PagePolicy policy) {
+    if (policy == PAGE_4K) {
+        prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0);
+    }
+}
+
+#endif // PAGEPOLICY_HPP
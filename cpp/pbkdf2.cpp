@@ -1,14 +1,27 @@
 #include <openssl/evp.h>
 #include <string.h>
+#include <climits>
+#include <string_view>
 #include "framework.hpp"
+#include "pbkdf2_mb.hpp"
 
 class Pbkdf2: public HashBenchmark {
     private:
         int iters;
         static const int hashLen = 32;
         static const int saltLen = 16;
-        void _hashInternal(const std::string &password, unsigned char *hash, unsigned char *salt) {
-            PKCS5_PBKDF2_HMAC(password.c_str(), password.length(), salt, 16, iters, EVP_sha256(), hashLen, hash);
+        static const int recordLen = 2 * saltLen + 1 + 2 * hashLen;
+        // Passwords derived per lane-parallel call in hashBatch, one full group for the widest kernel
+        static const size_t batchChunk = 16;
+        void _hashInternal(std::string_view password, unsigned char *hash, const unsigned char *salt) {
+            PKCS5_PBKDF2_HMAC(password.data(), password.length(), salt, saltLen, iters, EVP_sha256(), hashLen, hash);
+        }
+
+        // hex(salt)$hex(hash), recordLen chars
+        void encode(const unsigned char *salt, const unsigned char *hash, char *out) {
+            hexify(salt, saltLen, out);
+            out[2 * saltLen] = '$';
+            hexify(hash, hashLen, out + 2 * saltLen + 1);
         }
     public:
         Pbkdf2(std::string name, int iters) : HashBenchmark(name), iters(iters) {}
@@ -18,28 +31,105 @@ class Pbkdf2: public HashBenchmark {
             uint8_t salt[saltLen];
             generateSeed(saltLen, (char *) salt);
             _hashInternal(password, hash, salt);
-            std::string resStr;
-            resStr.reserve(2 * hashLen + 2 * saltLen + 1);
-            hexify(salt, saltLen, resStr);
-            resStr.push_back('$');
-            hexify(hash, hashLen, resStr);
-            return resStr;
+            char res[recordLen];
+            encode(salt, hash, res);
+            return std::string(res, recordLen);
         }
 
         bool _checkHash(const std::string &hash, const std::string &password) {
-            if (hash.length() != 2 * hashLen + 2 * saltLen + 1 || hash[2 * saltLen] != '$') {
+            if (hash.length() != recordLen || hash[2 * saltLen] != '$') {
                 return false;
             }
-            uint8_t hsh[hashLen];
             uint8_t salt[saltLen];
-            for (int i = 0; i < saltLen; i++) {
-                char byte[3] = {hash[2 * i], hash[2 * i + 1], 0};
-                salt[i] = (uint8_t) strtol(byte, NULL, 16);
+            uint8_t expected[hashLen];
+            uint8_t hsh[hashLen];
+            if (!unhexify(hash.data(), saltLen, salt) || !unhexify(hash.data() + 2 * saltLen + 1, hashLen, expected)) {
+                return false;
             }
             _hashInternal(password, hsh, salt);
-            std::string resStr;
-            resStr.reserve(2 * hashLen);
-            hexify(hsh, hashLen, resStr);
-            return memcmp(resStr.data(), hash.data() + 2 * saltLen + 1, 2 * hashLen) == 0;
+            return phc::digestEqual(hsh, expected, hashLen);
+        }
+
+        // $pbkdf2-sha256$i=<iters>$salt$hash
+        size_t phcHash(std::string_view password, char *out) {
+            PhcRecord rec;
+            strcpy(rec.id, "pbkdf2-sha256");
+            rec.addParam("i", iters);
+            rec.saltLen = saltLen;
+            rec.hashLen = hashLen;
+            generateSeed(saltLen, (char *) rec.salt);
+            _hashInternal(password, rec.hash, rec.salt);
+            return phc::encode(rec, out, PHC_MAX_LENGTH);
+        }
+
+        bool phcDerive(const PhcRecord &rec, std::string_view password, uint8_t *out) {
+            uint64_t i;
+            if (strcmp(rec.id, "pbkdf2-sha256") != 0 || !rec.param("i", i) || i == 0 || i > INT_MAX
+                    || i > costPolicy.covering(0, 1, 1, iters).maxIterations || rec.hashLen == 0) {
+                return false;
+            }
+            return PKCS5_PBKDF2_HMAC(password.data(), password.length(), rec.salt, rec.saltLen, i, EVP_sha256(), rec.hashLen, out) == 1;
+        }
+
+        size_t recordSize() {
+            return recordLen;
+        }
+
+        void hashBatch(const std::string_view *passwords, size_t count, char *out) {
+            sha256_mb::Isa isa = sha256_mb::bestIsa();
+            unsigned char salts[batchChunk * saltLen];
+            unsigned char hashes[batchChunk * hashLen];
+            for (size_t i = 0; i < count; i += batchChunk) {
+                size_t n = std::min(batchChunk, count - i);
+                generateSeed(n * saltLen, (char *) salts);
+                pbkdf2_mb::derive(passwords + i, salts, saltLen, n, iters, hashes, isa);
+                for (size_t j = 0; j < n; j++) {
+                    encode(salts + j * saltLen, hashes + j * hashLen, out + (i + j) * recordLen);
+                }
+            }
+        }
+
+        // Derive keys for a batch of passwords with the lane-parallel engine
+        // salts holds saltLen bytes per password, out receives hashLen raw bytes per password
+        void _hashBatch(const std::vector<std::string_view> &passwords, unsigned char *salts, unsigned char *out, sha256_mb::Isa isa) {
+            pbkdf2_mb::derive(passwords.data(), salts, saltLen, passwords.size(), iters, out, isa);
+        }
+
+        // Time taken to derive keys for every password in the file with one OpenSSL call each,
+        // into the same raw output buffer batchComputeTime fills, so the two compare kernel to kernel
+        double rawComputeTime(std::string passwordFile) {
+            const Corpus &passwords = Corpus::load(passwordFile);
+            std::vector<std::string_view> views = passwords.views();
+            std::vector<unsigned char> salts(passwords.size() * saltLen);
+            std::vector<unsigned char> out(passwords.size() * hashLen);
+            generateSeed(salts.size(), (char *) salts.data());
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < views.size(); i++) {
+                _hashInternal(views[i], out.data() + i * hashLen, salts.data() + i * saltLen);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double>(end - start).count();
+        }
+
+        // Time taken to compute hashes for every password in the file with the lane-parallel engine
+        // Every key is checked against OpenSSL afterwards, outside the timed region
+        double batchComputeTime(std::string passwordFile, sha256_mb::Isa isa) {
+            const Corpus &passwords = Corpus::load(passwordFile);
+            std::vector<std::string_view> views = passwords.views();
+            std::vector<unsigned char> salts(passwords.size() * saltLen);
+            std::vector<unsigned char> out(passwords.size() * hashLen);
+            generateSeed(salts.size(), (char *) salts.data());
+
+            auto start = std::chrono::high_resolution_clock::now();
+            _hashBatch(views, salts.data(), out.data(), isa);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            unsigned char hash[hashLen];
+            for (size_t i = 0; i < passwords.size(); i++) {
+                _hashInternal(passwords[i], hash, salts.data() + i * saltLen);
+                assert(memcmp(hash, out.data() + i * hashLen, hashLen) == 0);
+            }
+            return std::chrono::duration<double>(end - start).count();
         }
 };
\ No newline at end of file
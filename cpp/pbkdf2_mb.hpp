@@ -0,0 +1,229 @@
+#ifndef PBKDF2_MB_HPP
+#define PBKDF2_MB_HPP
+
+#include <openssl/crypto.h>
+#include "sha256_mb.hpp"
+
+// Lane-parallel PBKDF2-HMAC-SHA256 for a single 32-byte output block
+// The HMAC key is absorbed once per password into inner and outer pad states, so every iteration
+// costs exactly two compressions; each lane of the multi-buffer kernel carries one password
+namespace pbkdf2_mb {
+
+using namespace sha256_mb;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// Per-lane HMAC state, stored word-major so a row loads straight into a vector
+template<size_t L>
+struct Lanes {
+    alignas(64) uint32_t ipad[8][L];
+    alignas(64) uint32_t opad[8][L];
+    alignas(64) uint32_t u[8][L];  // Previous iteration output U_i
+    alignas(64) uint32_t t[8][L];  // Running xor of every U_i
+};
+
+// Compress one key block xored with pad into a fresh state
+static inline void padState(const unsigned char *key, unsigned char pad, uint32_t *state) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        unsigned char b[4] = {
+            (unsigned char) (key[4 * i] ^ pad), (unsigned char) (key[4 * i + 1] ^ pad),
+            (unsigned char) (key[4 * i + 2] ^ pad), (unsigned char) (key[4 * i + 3] ^ pad)
+        };
+        w[i] = load32be(b);
+    }
+    memcpy(state, IV, 32);
+    compress<uint32_t>(state, w);
+    OPENSSL_cleanse(w, sizeof(w));
+}
+
+// Absorb a || b and the final padding into state, which already holds one 64-byte pad block
+static inline void finish(uint32_t *state, const unsigned char *a, size_t aLen, const unsigned char *b, size_t bLen) {
+    size_t len = aLen + bLen;
+    size_t blocks = blockCount(len);
+    uint64_t bits = (uint64_t) (64 + len) * 8;
+    uint32_t w[16];
+    unsigned char blk[64];
+    for (size_t k = 0; k < blocks; k++) {
+        for (size_t j = 0; j < 64; j++) {
+            size_t pos = 64 * k + j;
+            blk[j] = pos < aLen ? a[pos] : pos < len ? b[pos - aLen] : pos == len ? 0x80 : 0;
+        }
+        if (k == blocks - 1) {
+            for (int i = 0; i < 8; i++) {
+                blk[63 - i] = (unsigned char) (bits >> (8 * i));
+            }
+        }
+        for (int i = 0; i < 16; i++) {
+            w[i] = load32be(blk + 4 * i);
+        }
+        compress<uint32_t>(state, w);
+    }
+    OPENSSL_cleanse(blk, sizeof(blk));
+    OPENSSL_cleanse(w, sizeof(w));
+}
+
+// Precompute the pad states for one password and run the first iteration U_1 = HMAC(P, S || 1)
+// This is a handful of compressions per password, so it stays scalar; both HMAC passes continue
+// from the pad states, so nothing is allocated and every key-derived buffer is wiped
+static inline void prepare(std::string_view password, const unsigned char *salt, size_t saltLen,
+                           uint32_t *ipad, uint32_t *opad, uint32_t *u) {
+    unsigned char key[64] = {0};
+    if (password.size() > 64) {
+        hash(&password, 1, key, SCALAR);
+    } else {
+        memcpy(key, password.data(), password.size());
+    }
+    padState(key, 0x36, ipad);
+    padState(key, 0x5c, opad);
+    OPENSSL_cleanse(key, sizeof(key));
+
+    static const unsigned char one[4] = {0, 0, 0, 1};
+    uint32_t st[8];
+    unsigned char digest[32];
+    memcpy(st, ipad, 32);
+    finish(st, salt, saltLen, one, sizeof(one));
+    for (int i = 0; i < 8; i++) {
+        store32be(digest + 4 * i, st[i]);
+    }
+    memcpy(u, opad, 32);
+    finish(u, digest, sizeof(digest), NULL, 0);
+    OPENSSL_cleanse(st, sizeof(st));
+    OPENSSL_cleanse(digest, sizeof(digest));
+}
+
+// Run iterations 2..iters on every lane: U_i = HMAC(P, U_{i-1}), T ^= U_i
+// Both messages are a 32-byte digest after a full pad block, so the padding words are constant
+template<class V, size_t L>
+static inline __attribute__((always_inline)) void iterate(Lanes<L> &lanes, uint32_t iters) {
+    V ipad[8], opad[8], u[8], t[8];
+    for (int i = 0; i < 8; i++) {
+        memcpy(&ipad[i], lanes.ipad[i], sizeof(V));
+        memcpy(&opad[i], lanes.opad[i], sizeof(V));
+        memcpy(&u[i], lanes.u[i], sizeof(V));
+        t[i] = u[i];
+    }
+    for (uint32_t it = 1; it < iters; it++) {
+        V w[16], st[8];
+        for (int i = 0; i < 8; i++) {
+            w[i] = u[i];
+            w[i + 8] = V{};
+            st[i] = ipad[i];
+        }
+        w[8] = V{} + 0x80000000;
+        w[15] = V{} + (64 + 32) * 8;
+        compress(st, w);
+        for (int i = 0; i < 8; i++) {
+            w[i] = st[i];
+            st[i] = opad[i];
+        }
+        compress(st, w);
+        for (int i = 0; i < 8; i++) {
+            u[i] = st[i];
+            t[i] ^= st[i];
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        memcpy(lanes.t[i], &t[i], sizeof(V));
+    }
+}
+
+static void iterateScalar(Lanes<1> &lanes, uint32_t iters) {
+    iterate<uint32_t, 1>(lanes, iters);
+}
+
+__attribute__((target("sse2")))
+static void iterateSse2(Lanes<4> &lanes, uint32_t iters) {
+    iterate<v4u32, 4>(lanes, iters);
+}
+
+__attribute__((target("avx2")))
+static void iterateAvx2(Lanes<8> &lanes, uint32_t iters) {
+    iterate<v8u32, 8>(lanes, iters);
+}
+
+__attribute__((target("avx512f")))
+static void iterateAvx512(Lanes<16> &lanes, uint32_t iters) {
+    iterate<v16u32, 16>(lanes, iters);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void iterateShani(Lanes<1> &lanes, uint32_t iters) {
+    alignas(16) uint32_t w[16] = {0};
+    uint32_t st[8], t[8];
+    w[8] = 0x80000000;
+    w[15] = (64 + 32) * 8;
+    for (int i = 0; i < 8; i++) {
+        w[i] = lanes.u[i][0];
+        t[i] = w[i];
+    }
+    for (uint32_t it = 1; it < iters; it++) {
+        for (int i = 0; i < 8; i++) {
+            st[i] = lanes.ipad[i][0];
+        }
+        compressShani<true>(st, w);
+        memcpy(w, st, 32);
+        for (int i = 0; i < 8; i++) {
+            st[i] = lanes.opad[i][0];
+        }
+        compressShani<true>(st, w);
+        memcpy(w, st, 32);
+        for (int i = 0; i < 8; i++) {
+            t[i] ^= st[i];
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        lanes.t[i][0] = t[i];
+    }
+}
+
+template<size_t L>
+static void deriveLanes(const std::string_view *passwords, const unsigned char *salts, size_t saltLen, size_t n,
+                        uint32_t iters, unsigned char *out, void (*kernel)(Lanes<L> &, uint32_t)) {
+    Lanes<L> lanes;
+    for (size_t base = 0; base < n; base += L) {
+        size_t count = std::min(L, n - base);
+        for (size_t l = 0; l < L; l++) {
+            // Idle lanes in the last group repeat the first password and are discarded
+            size_t src = l < count ? base + l : base;
+            uint32_t ipad[8], opad[8], u[8];
+            prepare(passwords[src], salts + src * saltLen, saltLen, ipad, opad, u);
+            for (int i = 0; i < 8; i++) {
+                lanes.ipad[i][l] = ipad[i];
+                lanes.opad[i][l] = opad[i];
+                lanes.u[i][l] = u[i];
+            }
+            OPENSSL_cleanse(ipad, sizeof(ipad));
+            OPENSSL_cleanse(opad, sizeof(opad));
+            OPENSSL_cleanse(u, sizeof(u));
+        }
+        kernel(lanes, iters);
+        for (size_t l = 0; l < count; l++) {
+            for (int i = 0; i < 8; i++) {
+                store32be(out + 32 * (base + l) + 4 * i, lanes.t[i][l]);
+            }
+        }
+    }
+    OPENSSL_cleanse(&lanes, sizeof(lanes));
+}
+
+// Derive a 32-byte PBKDF2-HMAC-SHA256 key for each of n passwords, each with its own saltLen-byte
+// salt from salts, writing 32 bytes per password into out
+// The caller must check isaSupported(isa) first
+inline void derive(const std::string_view *passwords, const unsigned char *salts, size_t saltLen, size_t n,
+                   uint32_t iters, unsigned char *out, Isa isa) {
+    switch (isa) {
+        case SCALAR: deriveLanes<1>(passwords, salts, saltLen, n, iters, out, iterateScalar); break;
+        case SSE2: deriveLanes<4>(passwords, salts, saltLen, n, iters, out, iterateSse2); break;
+        case AVX2: deriveLanes<8>(passwords, salts, saltLen, n, iters, out, iterateAvx2); break;
+        case AVX512: deriveLanes<16>(passwords, salts, saltLen, n, iters, out, iterateAvx512); break;
+        case SHANI: deriveLanes<1>(passwords, salts, saltLen, n, iters, out, iterateShani); break;
+    }
+}
+
+#pragma GCC diagnostic pop
+
+}  // namespace pbkdf2_mb
+
+#endif // PBKDF2_MB_HPP
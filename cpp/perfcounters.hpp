@@ -0,0 +1,147 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+enum PerfCounter { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_DTLB_MISSES, PERF_PAGE_FAULTS, PERF_COUNTER_COUNT };
+
+// Counter totals over one benchmark phase, and how many hashes the phase ran
+// A counter the host could not provide (no PMU in a VM, perf_event_paranoid, ...) is left invalid
+struct PerfCounts {
+    uint64_t values[PERF_COUNTER_COUNT] = {};
+    bool valid[PERF_COUNTER_COUNT] = {};
+    uint64_t hashes = 0;
+
+    static const char *csvHeader() {
+        return "Cycles/Hash,Instructions/Hash,IPC,LLCMisses/Hash,dTLBMisses/Hash,PageFaults/Hash";
+    }
+
+    // Per-hash values, with an empty field for anything not counted
+    void writeCsv(std::ostream &f) const {
+        auto perHash = [&](PerfCounter c) {
+            if (valid[c] && hashes != 0) {
+                f << (double) values[c] / hashes;
+            }
+        };
+        perHash(PERF_CYCLES);
+        f << ",";
+        perHash(PERF_INSTRUCTIONS);
+        f << ",";
+        if (valid[PERF_CYCLES] && valid[PERF_INSTRUCTIONS] && values[PERF_CYCLES] != 0) {
+            f << (double) values[PERF_INSTRUCTIONS] / values[PERF_CYCLES];
+        }
+        f << ",";
+        perHash(PERF_LLC_MISSES);
+        f << ",";
+        perHash(PERF_DTLB_MISSES);
+        f << ",";
+        perHash(PERF_PAGE_FAULTS);
+    }
+
+    PerfCounts &operator+=(const PerfCounts &other) {
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            values[c] += other.values[c];
+            valid[c] = (valid[c] || hashes == 0) && other.valid[c];
+        }
+        hashes += other.hashes;
+        return *this;
+    }
+};
+
+// perf_event_open counters for the calling thread and every thread it creates while open,
+// scheduled as one group so ratios such as IPC come from the same intervals
+// Counters that fail to open are skipped; with none at all, stop() returns nothing valid
+// Off unless enabled, since inherited counters add a little to every thread creation
+class PerfGroup {
+    private:
+        int fds[PERF_COUNTER_COUNT];
+        int leader = -1;
+
+        static int open(uint32_t type, uint64_t config, int group) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = group == -1;
+            attr.inherit = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+            if (fd < 0) {
+                // Unprivileged users may only count user space
+                attr.exclude_kernel = 1;
+                fd = syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+            }
+            return fd;
+        }
+
+        static uint64_t cacheMiss(uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+
+    public:
+        inline static bool enabled = false;
+
+        PerfGroup() {
+            static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTER_COUNT] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_LL)},
+                {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB)},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+            };
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                fds[c] = enabled ? open(events[c].type, events[c].config, leader) : -1;
+                // The first counter that opens leads the group
+                if (leader == -1) {
+                    leader = fds[c];
+                }
+            }
+        }
+
+        PerfGroup(const PerfGroup &) = delete;
+        PerfGroup &operator=(const PerfGroup &) = delete;
+
+        ~PerfGroup() {
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                if (fds[c] >= 0) {
+                    close(fds[c]);
+                }
+            }
+        }
+
+        void start() {
+            if (leader >= 0) {
+                ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+
+        // Totals since start, scaled up if the kernel had to multiplex the group
+        PerfCounts stop(uint64_t hashes) {
+            PerfCounts counts;
+            counts.hashes = hashes;
+            if (leader < 0) {
+                return counts;
+            }
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                uint64_t data[3];  // value, time enabled, time running
+                if (fds[c] < 0 || read(fds[c], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+                    continue;
+                }
+                counts.values[c] = data[2] < data[1] ? (uint64_t) ((double) data[0] * data[1] / data[2]) : data[0];
+                counts.valid[c] = true;
+            }
+            return counts;
+        }
+};
+
+#endif // PERFCOUNTERS_HPP
\ No newline at end of file
@@ -0,0 +1,279 @@
+#ifndef PHC_HPP
+#define PHC_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <openssl/crypto.h>
+
+// PHC string format: $<id>[$v=<version>][$<param>=<value>(,<param>=<value>)*][$<salt>[$<hash>]]
+// Salt and hash are standard base64 without padding; every parameter value here is a decimal integer
+// Records decode into fixed-size buffers, so neither direction touches the heap
+
+// Longest PHC string any algorithm here emits, NUL included
+static const size_t PHC_MAX_LENGTH = 512;
+
+// Ceiling on the cost a PHC string, or any other hash read back from outside, may ask of a
+// derivation. Such strings come from target files and stored credentials, so parameters past it
+// are rejected before any memory is allocated or thread started
+// The defaults leave room over every configuration the benchmarks use
+struct PhcCostPolicy {
+    size_t maxMemory = (size_t) 1 << 30;  // Bytes one derivation may allocate
+    uint64_t maxLanes = 16;               // Argon2 lanes (and threads), scrypt p
+    uint64_t maxPasses = 64;              // Argon2 t
+    uint64_t maxIterations = 10000000;    // PBKDF2 i
+
+    // This policy raised to an instance's own configuration, so an instance configured past the
+    // defaults still verifies its own hashes; only foreign parameters are held to the defaults
+    PhcCostPolicy covering(size_t memory, uint64_t lanes, uint64_t passes, uint64_t iterations) const {
+        PhcCostPolicy cap = *this;
+        cap.maxMemory = std::max(cap.maxMemory, memory);
+        cap.maxLanes = std::max(cap.maxLanes, lanes);
+        cap.maxPasses = std::max(cap.maxPasses, passes);
+        cap.maxIterations = std::max(cap.maxIterations, iterations);
+        return cap;
+    }
+};
+
+struct PhcRecord {
+    static const size_t maxId = 31;
+    static const size_t maxParams = 8;
+    static const size_t maxParamName = 7;
+    static const size_t maxSalt = 64;
+    static const size_t maxHash = 256;  // Plaintext stores the whole password here
+
+    struct Param {
+        char name[maxParamName + 1];
+        uint64_t value;
+    };
+
+    char id[maxId + 1] = {};
+    bool hasVersion = false;
+    uint32_t version = 0;
+    Param params[maxParams];
+    size_t paramCount = 0;
+    uint8_t salt[maxSalt];
+    size_t saltLen = 0;
+    uint8_t hash[maxHash];
+    size_t hashLen = 0;
+
+    bool param(const char *name, uint64_t &value) const {
+        for (size_t i = 0; i < paramCount; i++) {
+            if (strcmp(params[i].name, name) == 0) {
+                value = params[i].value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool addParam(const char *name, uint64_t value) {
+        if (paramCount == maxParams || strlen(name) > maxParamName) {
+            return false;
+        }
+        strcpy(params[paramCount].name, name);
+        params[paramCount].value = value;
+        paramCount++;
+        return true;
+    }
+};
+
+namespace phc {
+
+static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+inline size_t b64Length(size_t bytes) {
+    return bytes / 3 * 4 + (bytes % 3 ? bytes % 3 + 1 : 0);
+}
+
+inline char *b64Encode(const uint8_t *src, size_t len, char *out) {
+    for (; len >= 3; len -= 3, src += 3) {
+        *out++ = b64[src[0] >> 2];
+        *out++ = b64[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+        *out++ = b64[((src[1] & 0x0f) << 2) | (src[2] >> 6)];
+        *out++ = b64[src[2] & 0x3f];
+    }
+    if (len > 0) {
+        *out++ = b64[src[0] >> 2];
+        if (len == 1) {
+            *out++ = b64[(src[0] & 0x03) << 4];
+        } else {
+            *out++ = b64[((src[0] & 0x03) << 4) | (src[1] >> 4)];
+            *out++ = b64[(src[1] & 0x0f) << 2];
+        }
+    }
+    return out;
+}
+
+// Reverse of b64, -1 for characters outside it
+struct B64Table {
+    int8_t value[256];
+    constexpr B64Table() : value() {
+        for (int i = 0; i < 256; i++) {
+            value[i] = -1;
+        }
+        for (int i = 0; i < 64; i++) {
+            value[(unsigned char) b64[i]] = i;
+        }
+    }
+};
+static constexpr B64Table b64Table;
+
+// Decode into at most cap bytes; rejects bad characters, a dangling single char and non-zero pad bits
+inline bool b64Decode(std::string_view in, uint8_t *out, size_t cap, size_t &len) {
+    if (in.size() % 4 == 1) {
+        return false;
+    }
+    len = in.size() / 4 * 3 + (in.size() % 4 ? in.size() % 4 - 1 : 0);
+    if (len > cap) {
+        return false;
+    }
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t pos = 0;
+    for (char c : in) {
+        int v = b64Table.value[(unsigned char) c];
+        if (v < 0) {
+            return false;
+        }
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[pos++] = (uint8_t) (acc >> bits);
+        }
+    }
+    return (acc & ((1u << bits) - 1)) == 0;
+}
+
+inline bool parseDecimal(std::string_view s, uint64_t &value) {
+    if (s.empty() || s.size() > 19 || (s.size() > 1 && s[0] == '0')) {
+        return false;
+    }
+    value = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+inline bool decode(std::string_view s, PhcRecord &rec) {
+    rec.hasVersion = false;
+    rec.paramCount = rec.saltLen = rec.hashLen = 0;
+    std::string_view fields[5];
+    size_t count = 0;
+    if (s.empty() || s[0] != '$') {
+        return false;
+    }
+    s.remove_prefix(1);
+    while (true) {
+        if (count == 5) {
+            return false;
+        }
+        size_t end = s.find('$');
+        fields[count++] = s.substr(0, end);
+        if (end == std::string_view::npos) {
+            break;
+        }
+        s.remove_prefix(end + 1);
+    }
+    size_t f = 0;
+    std::string_view id = fields[f++];
+    if (id.empty() || id.size() > PhcRecord::maxId) {
+        return false;
+    }
+    memcpy(rec.id, id.data(), id.size());
+    rec.id[id.size()] = 0;
+    uint64_t value;
+    if (f < count && fields[f].substr(0, 2) == "v=") {
+        if (!parseDecimal(fields[f].substr(2), value) || value > UINT32_MAX) {
+            return false;
+        }
+        rec.hasVersion = true;
+        rec.version = (uint32_t) value;
+        f++;
+    }
+    // A parameter field is the only one that can hold '='
+    if (f < count && fields[f].find('=') != std::string_view::npos) {
+        std::string_view params = fields[f++];
+        while (!params.empty()) {
+            size_t comma = params.find(',');
+            std::string_view param = params.substr(0, comma);
+            size_t eq = param.find('=');
+            if (eq == std::string_view::npos || eq == 0 || eq > PhcRecord::maxParamName
+                    || rec.paramCount == PhcRecord::maxParams || !parseDecimal(param.substr(eq + 1), value)) {
+                return false;
+            }
+            PhcRecord::Param &p = rec.params[rec.paramCount++];
+            memcpy(p.name, param.data(), eq);
+            p.name[eq] = 0;
+            p.value = value;
+            params = comma == std::string_view::npos ? std::string_view() : params.substr(comma + 1);
+        }
+    }
+    if (f < count && !b64Decode(fields[f++], rec.salt, PhcRecord::maxSalt, rec.saltLen)) {
+        return false;
+    }
+    if (f < count && !b64Decode(fields[f++], rec.hash, PhcRecord::maxHash, rec.hashLen)) {
+        return false;
+    }
+    return f == count;
+}
+
+// Writes the string and a NUL into out; returns its length, or 0 if it needs more than size bytes
+inline size_t encode(const PhcRecord &rec, char *out, size_t size) {
+    size_t need = 1 + strlen(rec.id) + 1;
+    if (rec.hasVersion) {
+        need += 4 + 10;
+    }
+    for (size_t i = 0; i < rec.paramCount; i++) {
+        need += 1 + strlen(rec.params[i].name) + 1 + 20;
+    }
+    need += 1 + b64Length(rec.saltLen) + 1 + b64Length(rec.hashLen);
+    if (need > size) {
+        return 0;
+    }
+    char *p = out;
+    auto putDecimal = [&](uint64_t v) {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        while (n) {
+            *p++ = digits[--n];
+        }
+    };
+    *p++ = '$';
+    p = stpcpy(p, rec.id);
+    if (rec.hasVersion) {
+        p = stpcpy(p, "$v=");
+        putDecimal(rec.version);
+    }
+    for (size_t i = 0; i < rec.paramCount; i++) {
+        *p++ = i == 0 ? '$' : ',';
+        p = stpcpy(p, rec.params[i].name);
+        *p++ = '=';
+        putDecimal(rec.params[i].value);
+    }
+    *p++ = '$';
+    p = b64Encode(rec.salt, rec.saltLen, p);
+    *p++ = '$';
+    p = b64Encode(rec.hash, rec.hashLen, p);
+    *p = 0;
+    return p - out;
+}
+
+// Compare digests without an early exit, so timing says nothing about where they differ
+inline bool digestEqual(const uint8_t *a, const uint8_t *b, size_t len) {
+    return CRYPTO_memcmp(a, b, len) == 0;
+}
+
+} // namespace phc
+
+#endif // PHC_HPP
\ No newline at end of file
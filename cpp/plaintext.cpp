@@ -1,6 +1,9 @@
 #include "framework.hpp"
 
 class Plaintext: public HashBenchmark {
+    private:
+        // Longest password a batch record can hold
+        static const int recordLen = 256;
     public:
         Plaintext(std::string name) : HashBenchmark(name) {}
 
@@ -11,4 +14,35 @@ class Plaintext: public HashBenchmark {
         bool _checkHash(const std::string &hash, const std::string &password) {
             return password == hash;
         }
+
+        // $plaintext$$<password>; the password itself is the digest
+        size_t phcHash(std::string_view password, char *out) {
+            PhcRecord rec;
+            assert(password.size() <= PhcRecord::maxHash);
+            strcpy(rec.id, "plaintext");
+            rec.hashLen = password.size();
+            memcpy(rec.hash, password.data(), password.size());
+            return phc::encode(rec, out, PHC_MAX_LENGTH);
+        }
+
+        // Passwords of another length cannot match, so they are rejected before any comparison
+        bool phcDerive(const PhcRecord &rec, std::string_view password, uint8_t *out) {
+            if (strcmp(rec.id, "plaintext") != 0 || rec.saltLen != 0 || rec.hashLen != password.size()) {
+                return false;
+            }
+            memcpy(out, password.data(), password.size());
+            return true;
+        }
+
+        size_t recordSize() {
+            return recordLen;
+        }
+
+        void hashBatch(const std::string_view *passwords, size_t count, char *out) {
+            for (size_t i = 0; i < count; i++, out += recordLen) {
+                assert(passwords[i].size() <= recordLen);
+                memcpy(out, passwords[i].data(), passwords[i].size());
+                memset(out + passwords[i].size(), 0, recordLen - passwords[i].size());
+            }
+        }
 };
\ No newline at end of file
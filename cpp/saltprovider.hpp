@@ -0,0 +1,146 @@
+#ifndef SALTPROVIDER_HPP
+#define SALTPROVIDER_HPP
+
+#include <atomic>
+#include <fstream>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+#include <pthread.h>
+#include <sys/random.h>
+#include "sha256_mb.hpp"
+
+// Where salts come from
+// SALT_URANDOM opens /dev/urandom for every salt, as the benchmarks originally did
+// SALT_POOL refills a per-thread buffer from getrandom(2) in large batches
+// SALT_SEEDED expands a fixed seed with SHA-256 in counter mode, so runs are reproducible
+enum SaltMode { SALT_URANDOM, SALT_POOL, SALT_SEEDED };
+
+// Per-thread buffer of salt bytes not yet handed out
+struct SaltPool {
+    static const size_t size = 8192;
+    unsigned char buf[size];
+    size_t pos = size;
+    unsigned int epoch = ~0u;
+    uint64_t thread = 0;   // Ordinal of this thread's seeded stream
+    uint64_t counter = 0;  // Next seeded block
+};
+
+class SaltProvider {
+    private:
+        typedef SaltPool Pool;
+        static const size_t poolSize = SaltPool::size;
+
+        inline static std::atomic<SaltMode> mode{SALT_POOL};
+        inline static std::atomic<uint64_t> seed{0};
+        // Bumped on every mode change and in forked children so stale buffers are dropped; in pool
+        // mode a child then never hands out the same salts as its parent. Seeded streams restart at
+        // thread 0, counter 0 instead, so every forked child replays the parent's salts exactly and
+        // an isolated run sees the same salts as an in-process one
+        inline static std::atomic<unsigned int> epoch{0};
+        inline static std::atomic<uint64_t> nextThread{0};
+        inline static thread_local Pool pool;
+
+        static void resetStreams() {
+            nextThread = 0;
+            epoch++;
+        }
+
+        static bool registerFork() {
+            pthread_atfork(NULL, NULL, resetStreams);
+            return true;
+        }
+
+        static void refillSystem(Pool &p) {
+            size_t got = 0;
+            while (got < poolSize) {
+                ssize_t n = getrandom(p.buf + got, poolSize - got, 0);
+                assert(n > 0 || errno == EINTR);
+                if (n > 0) {
+                    got += n;
+                }
+            }
+        }
+
+        // Block i of a thread's stream is SHA-256(seed || thread || i), hashed a whole pool at a time
+        static void refillSeeded(Pool &p) {
+            const size_t blocks = poolSize / 32;
+            uint64_t msgs[blocks][3];
+            std::string_view views[blocks];
+            for (size_t i = 0; i < blocks; i++) {
+                msgs[i][0] = seed;
+                msgs[i][1] = p.thread;
+                msgs[i][2] = p.counter++;
+                views[i] = std::string_view((const char *) msgs[i], sizeof(msgs[i]));
+            }
+            sha256_mb::hash(views, blocks, p.buf, sha256_mb::bestIsa());
+        }
+
+        static void fillUrandom(char *out, size_t size) {
+            std::ifstream urandom("/dev/urandom", std::ios::in | std::ios::binary);
+            urandom.read(out, size);
+            urandom.close();
+        }
+
+    public:
+        // Switch every thread to a mode; seed only matters for SALT_SEEDED
+        // Seeded streams restart, and threads get stream ordinals in the order they next ask for a salt
+        static void setMode(SaltMode newMode, uint64_t newSeed = 0) {
+            seed = newSeed;
+            mode = newMode;
+            resetStreams();
+        }
+
+        static SaltMode getMode() {
+            return mode;
+        }
+
+        static void fill(char *out, size_t size) {
+            static bool registered = registerFork();
+            (void) registered;
+            SaltMode m = mode;
+            if (m == SALT_URANDOM) {
+                fillUrandom(out, size);
+                return;
+            }
+            Pool &p = pool;
+            unsigned int e = epoch;
+            if (p.epoch != e) {
+                p.epoch = e;
+                p.pos = poolSize;
+                p.counter = 0;
+                p.thread = nextThread++;
+            }
+            while (size > 0) {
+                if (p.pos == poolSize) {
+                    if (m == SALT_SEEDED) {
+                        refillSeeded(p);
+                    } else {
+                        refillSystem(p);
+                    }
+                    p.pos = 0;
+                }
+                size_t take = std::min(size, poolSize - p.pos);
+                memcpy(out, p.buf + p.pos, take);
+                // Handed-out bytes are wiped so they never linger in the buffer
+                memset(p.buf + p.pos, 0, take);
+                p.pos += take;
+                out += take;
+                size -= take;
+            }
+        }
+};
+
+inline const char *saltModeName(SaltMode mode) {
+    switch (mode) {
+        case SALT_URANDOM: return "urandom";
+        case SALT_POOL: return "getrandom-pool";
+        case SALT_SEEDED: return "seeded";
+    }
+    return "unknown";
+}
+
+#endif // SALTPROVIDER_HPP
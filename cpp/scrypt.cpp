@@ -1,48 +1,202 @@
-#include <crypt.h>
 #include <string.h>
-#include <errno.h>
 #include "framework.hpp"
 #include "base64.h"
+#include "cryptrn.hpp"
+#include "scrypt_core.hpp"
 
 class Scrypt: public HashBenchmark {
     private:
         int r, p, npow = 0;
+        unsigned int threads;
+        bool arena = false;
+        PagePolicy policy = PAGE_DEFAULT;
+        scrypt_core::Isa isa = scrypt_core::defaultIsa();
         static const int hashLen = 64;
         static const int saltLen = 18;
+        // Salt as crypt-base64 without padding
+        static const int b64SaltLen = saltLen / 3 * 4;
+        // $7$Nrrrrrppppp$salt$ and the setting followed by 43 chars of hash
+        static const int settingLen = 3 + 11 + 1 + b64SaltLen + 1;
+        static const int recordLen = settingLen + 43;
+        // Derived key behind those 43 chars
+        static const int keyLen = 32;
+        // The salt scrypt itself sees runs from after the parameters up to the last '$', so it
+        // includes the '$' this setting places before the base64 salt
+        static const int kdfSaltOffset = 3 + 11;
+        static const int kdfSaltLen = 1 + b64SaltLen;
 
-        std::string _hashInternal(const std::string &password, const char *configStr) {
-            char *data = crypt(password.c_str(), configStr);
-            assert(errno == 0);
-            return std::string(data);
+        // The callbacks take no context pointer, so the calling thread's policy and work regions
+        // are thread_local; the regions are allocated on the thread that called scrypt_core::derive
+        inline static thread_local PagePolicy callPolicy = PAGE_DEFAULT;
+        inline static thread_local PageArena workerArena;
+
+        static int pagesAllocate(uint8_t **memory, size_t bytes) {
+            void *mem = mapPages(bytes, callPolicy);
+            if (mem == MAP_FAILED) {
+                return scrypt_core::MEMORY_ALLOCATION_ERROR;
+            }
+            *memory = (uint8_t *) mem;
+            return scrypt_core::OK;
+        }
+
+        static void pagesFree(uint8_t *memory, size_t bytes) {
+            unmapPages(memory, bytes, callPolicy);
+        }
+
+        static int arenaAllocate(uint8_t **memory, size_t bytes) {
+            *memory = workerArena.reserve(bytes, callPolicy);
+            return *memory == NULL ? scrypt_core::MEMORY_ALLOCATION_ERROR : scrypt_core::OK;
+        }
+
+        // The regions stay mapped for the next hash
+        static void arenaFree(uint8_t *memory, size_t bytes) {}
+
+        // scrypt with explicit parameters into keyLen bytes of key; false on parameters it rejects
+        bool _hashInternal(std::string_view password, const uint8_t *salt, size_t saltSize, uint64_t n, uint32_t rr, uint32_t pp, uint8_t *key) {
+            callPolicy = policy;
+            bool custom = policy != PAGE_DEFAULT;
+            return scrypt_core::derive((const uint8_t *) password.data(), password.size(), salt, saltSize, n, rr, pp,
+                std::min(threads, pp), isa,
+                arena ? arenaAllocate : custom ? pagesAllocate : NULL,
+                arena ? arenaFree : custom ? pagesFree : NULL,
+                key, keyLen) == scrypt_core::OK;
+        }
+
+        // Whether parameters read back from a hash stay within costPolicy, raised to this instance's
+        // own configuration: p against the lane cap, and the work regions plus the p blocks of B
+        // against the memory cap; r * p < 2^30 is checked already. Hashing never consults it
+        bool withinPolicy(uint64_t n, uint32_t rr, uint32_t pp) {
+            PhcCostPolicy cap = costPolicy.covering(memoryCost() + (size_t) 128 * r * p, p, 0, 0);
+            if (pp > cap.maxLanes) {
+                return false;
+            }
+            size_t work = scrypt_core::memoryBytes(n, rr, pp, std::min(threads, pp), isa);
+            return work != 0 && work <= cap.maxMemory && (size_t) 128 * rr * pp <= cap.maxMemory - work;
+        }
+
+        // Write the setting for a fresh salt, NUL-terminated; r and p take all 5 chars each, so any
+        // value up to 2^30 reads back, not just the 64 a single char holds
+        void writeSetting(char *configStr) {
+            uint8_t salt[saltLen];
+            generateSeed(saltLen, (char *) salt);
+            char b64salt[b64SaltLen + 1];
+            cryptEncodeSalt(salt, saltLen, b64salt);
+            char *pos = configStr + sprintf(configStr, "$7$%c", base64_table[npow]);
+            pos = cryptEncodeUint30(p, cryptEncodeUint30(r, pos));
+            sprintf(pos, "$%s$", b64salt);
+        }
+
+        // Setting followed by the key, as libxcrypt writes it; returns the end of the record
+        char *writeRecord(std::string_view password, char *out) {
+            writeSetting(out);
+            uint8_t key[keyLen];
+            assert(_hashInternal(password, (const uint8_t *) out + kdfSaltOffset, kdfSaltLen, (uint64_t) 1 << npow, r, p, key));
+            return cryptEncode64(key, keyLen, out + settingLen);
         }
     public:
-        Scrypt(std::string name, int n, int r, int p) : HashBenchmark(name), r(r), p(p) {
+        // Each hash runs its p instances one after another on the calling thread, as libxcrypt's $7$
+        // does, so time and memory (one V) stay comparable with the crypt-based numbers in results/
+        Scrypt(std::string name, int n, int r, int p) : HashBenchmark(name), r(r), p(p), threads(1), isa(scrypt_core::sequentialIsa()) {
             while (n > 1) {
                 n >>= 1;
                 npow++;
             }
         }
 
+        // Spreads the p instances over threads threads, each running as many side by side as the
+        // widest kernel allows; memory grows with both
+        // With arena set, each hashing thread reuses one pre-faulted work region instead of a fresh allocation
+        Scrypt(std::string name, int n, int r, int p, unsigned int threads, bool arena) : Scrypt(name, n, r, p) {
+            this->threads = std::max(1u, threads);
+            this->arena = arena;
+            isa = scrypt_core::defaultIsa();
+        }
+
+        bool setPagePolicy(PagePolicy policy) {
+            this->policy = policy;
+            return true;
+        }
+
+        // ROMix kernel for later hashes; false, and no change, if this CPU cannot run it
+        bool setIsa(scrypt_core::Isa isa) {
+            if (!scrypt_core::isaSupported(isa)) {
+                return false;
+            }
+            this->isa = isa;
+            return true;
+        }
+
+        scrypt_core::Isa kernel() const {
+            return isa;
+        }
+
         std::string _hash(const std::string &password) {
-            uint8_t salt[saltLen];
-            generateSeed(saltLen, (char *) salt);
-            size_t b64saltLen;
-            unsigned char *b64salt = base64_encode(salt, saltLen, &b64saltLen);
-            for (int i = b64saltLen; i >= 0; i--) { // Remove padding
-                if (b64salt[i] == '=' || b64salt[i] == '\n' || b64salt[i] == '\0') {
-                    b64salt[i] = 0;
-                } else {
-                    break;
-                }
-            }
-            // $7$Nrrrrrppppp$salt$
-            char configStr[18 + b64saltLen];
-            sprintf(configStr, "$7$%c%c....%c....$%s$", base64_table[npow], base64_table[r], base64_table[p], b64salt);
-            free(b64salt);
-            return _hashInternal(password, configStr);
+            char res[recordLen + 1];
+            writeRecord(password, res);
+            return std::string(res, recordLen);
         }
 
+        // Reads any $7$ hash, not only this instance's parameters, as libxcrypt does, up to costPolicy
         bool _checkHash(const std::string &hash, const std::string &password) {
-           return hash == _hashInternal(password, hash.c_str());
+            uint32_t rr, pp;
+            const void *ln = hash.size() > 3 ? memchr(base64_table, hash[3], 64) : NULL;
+            size_t last = hash.rfind('$');
+            if (hash.compare(0, 3, "$7$") != 0 || ln == NULL || hash.size() < kdfSaltOffset || last < kdfSaltOffset
+                    || !cryptDecodeUint30(hash.c_str() + 4, rr) || !cryptDecodeUint30(hash.c_str() + 9, pp)) {
+                return false;
+            }
+            uint8_t expected[keyLen], key[keyLen];
+            size_t keySize;
+            uint64_t lnValue = (const unsigned char *) ln - base64_table;
+            if (!cryptDecode64(std::string_view(hash).substr(last + 1), expected, keyLen, keySize) || keySize != keyLen
+                    || !withinPolicy((uint64_t) 1 << lnValue, rr, pp)
+                    || !_hashInternal(password, (const uint8_t *) hash.data() + kdfSaltOffset, last - kdfSaltOffset, (uint64_t) 1 << lnValue, rr, pp, key)) {
+                return false;
+            }
+            return phc::digestEqual(key, expected, keyLen);
+        }
+
+        // $scrypt$ln=<log2 N>,r=<r>,p=<p>$salt$hash with the salt scrypt actually used and the raw key
+        size_t phcHash(std::string_view password, char *out) {
+            char configStr[settingLen + 1];
+            writeSetting(configStr);
+            PhcRecord rec;
+            strcpy(rec.id, "scrypt");
+            rec.addParam("ln", npow);
+            rec.addParam("r", r);
+            rec.addParam("p", p);
+            rec.saltLen = kdfSaltLen;
+            memcpy(rec.salt, configStr + kdfSaltOffset, kdfSaltLen);
+            rec.hashLen = keyLen;
+            assert(_hashInternal(password, rec.salt, rec.saltLen, (uint64_t) 1 << npow, r, p, rec.hash));
+            return phc::encode(rec, out, PHC_MAX_LENGTH);
+        }
+
+        // Any salt bytes work, since the key is derived here and no $7$ setting is rebuilt
+        bool phcDerive(const PhcRecord &rec, std::string_view password, uint8_t *out) {
+            uint64_t ln, rr, pp;
+            if (strcmp(rec.id, "scrypt") != 0 || !rec.param("ln", ln) || !rec.param("r", rr)
+                    || !rec.param("p", pp) || ln == 0 || ln > 63 || rr == 0 || rr >= (1 << 30) || pp == 0 || pp >= (1 << 30)
+                    || rec.saltLen == 0 || rec.hashLen != keyLen || !withinPolicy((uint64_t) 1 << ln, rr, pp)) {
+                return false;
+            }
+            return _hashInternal(password, rec.salt, rec.saltLen, (uint64_t) 1 << ln, rr, pp, out);
+        }
+
+        // Each of the min(threads, p) workers holds V for as many instances as its kernel runs at once
+        size_t memoryCost() {
+            return scrypt_core::memoryBytes((uint64_t) 1 << npow, r, p, std::min(threads, (unsigned int) p), isa);
+        }
+
+        size_t recordSize() {
+            return recordLen;
+        }
+
+        void hashBatch(const std::string_view *passwords, size_t count, char *out) {
+            char record[recordLen + 1];
+            for (size_t i = 0; i < count; i++) {
+                writeRecord(passwords[i], record);
+                memcpy(out + i * recordLen, record, recordLen);
+            }
         }
 };
\ No newline at end of file
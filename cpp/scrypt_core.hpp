@@ -0,0 +1,496 @@
+#ifndef SCRYPT_CORE_HPP
+#define SCRYPT_CORE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+// In-tree scrypt (RFC 7914), the same function libxcrypt's $7$ computes, with the V arrays
+// allocated through callbacks so the caller decides how they are backed and whether they are reused
+// The p ROMix instances are independent: they are split over up to p threads, and each thread runs
+// its share several at a time, one instance per 128-bit lane of the widest vectors the CPU has
+// Every kernel (portable reference, SSE2, AVX2, AVX-512F) is compiled into the binary behind a
+// target attribute and one is picked at runtime from CPUID; HASHBENCH_SCRYPT_ISA=ref|sse2|avx2|avx512
+// forces one
+namespace scrypt_core {
+
+enum Isa { REF, SSE2, AVX2, AVX512 };
+static const Isa allIsas[] = {REF, SSE2, AVX2, AVX512};
+
+enum Status { OK = 0, INVALID_PARAMETERS = -1, MEMORY_ALLOCATION_ERROR = -2 };
+
+// Same shape as libargon2's allocation callbacks; allocate returns OK or an error
+typedef int (*AllocateCallback)(uint8_t **memory, size_t bytes);
+typedef void (*FreeCallback)(uint8_t *memory, size_t bytes);
+
+inline const char *isaName(Isa isa) {
+    switch (isa) {
+        case REF: return "ref";
+        case SSE2: return "sse2";
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+inline bool parseIsa(std::string_view name, Isa &isa) {
+    for (Isa candidate : allIsas) {
+        if (name == isaName(candidate)) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool isaSupported(Isa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case REF: return true;
+        case SSE2: return __builtin_cpu_supports("sse2");
+        case AVX2: return __builtin_cpu_supports("avx2");
+        case AVX512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+}
+
+inline Isa bestIsa() {
+    for (Isa isa : {AVX512, AVX2, SSE2}) {
+        if (isaSupported(isa)) {
+            return isa;
+        }
+    }
+    return REF;
+}
+
+// Kernel a new Scrypt uses: HASHBENCH_SCRYPT_ISA if this CPU runs it, else the widest one it has
+// Read once per process; a bad override is reported and ignored rather than left to fault later
+inline Isa defaultIsa() {
+    static const Isa chosen = []() {
+        const char *name = getenv("HASHBENCH_SCRYPT_ISA");
+        Isa isa;
+        if (name == NULL || *name == '\0') {
+            return bestIsa();
+        }
+        if (!parseIsa(name, isa)) {
+            std::cerr << "HASHBENCH_SCRYPT_ISA=" << name << " is not one of ref, sse2, avx2, avx512; detecting" << std::endl;
+            return bestIsa();
+        }
+        if (!isaSupported(isa)) {
+            std::cerr << "HASHBENCH_SCRYPT_ISA=" << name << " is not supported by this CPU; detecting" << std::endl;
+            return bestIsa();
+        }
+        return isa;
+    }();
+    return chosen;
+}
+
+// ROMix instances one call of a kernel runs side by side
+inline size_t width(Isa isa) {
+    switch (isa) {
+        case AVX2: return 2;
+        case AVX512: return 4;
+        default: return 1;
+    }
+}
+
+// Widest kernel that still runs one instance at a time, so one thread holds a single V as
+// libxcrypt's sequential ROMix does: the default kernel if it is one, else SSE2
+inline Isa sequentialIsa() {
+    Isa isa = defaultIsa();
+    return width(isa) == 1 ? isa : SSE2;
+}
+
+// ROMix over count consecutive blocks B of 128 * r bytes each, in place; work holds at least
+// min(count, width) * 128 * r * (N + 2) bytes, 64-byte aligned
+typedef void (*Romix)(uint8_t *B, size_t count, uint32_t r, uint64_t N, uint8_t *work);
+
+// Portable kernel, the shape of RFC 7914's reference code
+static inline uint32_t rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline void salsa8Ref(uint32_t *b) {
+    uint32_t x[16];
+    memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+        x[4] ^= rotl32(x[0] + x[12], 7);   x[8] ^= rotl32(x[4] + x[0], 9);
+        x[12] ^= rotl32(x[8] + x[4], 13);  x[0] ^= rotl32(x[12] + x[8], 18);
+        x[9] ^= rotl32(x[5] + x[1], 7);    x[13] ^= rotl32(x[9] + x[5], 9);
+        x[1] ^= rotl32(x[13] + x[9], 13);  x[5] ^= rotl32(x[1] + x[13], 18);
+        x[14] ^= rotl32(x[10] + x[6], 7);  x[2] ^= rotl32(x[14] + x[10], 9);
+        x[6] ^= rotl32(x[2] + x[14], 13);  x[10] ^= rotl32(x[6] + x[2], 18);
+        x[3] ^= rotl32(x[15] + x[11], 7);  x[7] ^= rotl32(x[3] + x[15], 9);
+        x[11] ^= rotl32(x[7] + x[3], 13);  x[15] ^= rotl32(x[11] + x[7], 18);
+        x[1] ^= rotl32(x[0] + x[3], 7);    x[2] ^= rotl32(x[1] + x[0], 9);
+        x[3] ^= rotl32(x[2] + x[1], 13);   x[0] ^= rotl32(x[3] + x[2], 18);
+        x[6] ^= rotl32(x[5] + x[4], 7);    x[7] ^= rotl32(x[6] + x[5], 9);
+        x[4] ^= rotl32(x[7] + x[6], 13);   x[5] ^= rotl32(x[4] + x[7], 18);
+        x[11] ^= rotl32(x[10] + x[9], 7);  x[8] ^= rotl32(x[11] + x[10], 9);
+        x[9] ^= rotl32(x[8] + x[11], 13);  x[10] ^= rotl32(x[9] + x[8], 18);
+        x[12] ^= rotl32(x[15] + x[14], 7); x[13] ^= rotl32(x[12] + x[15], 9);
+        x[14] ^= rotl32(x[13] + x[12], 13); x[15] ^= rotl32(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; i++) {
+        b[i] += x[i];
+    }
+}
+
+// BlockMix of in into out, even sub-blocks to the first half and odd ones to the second
+static void blockMixRef(const uint32_t *in, uint32_t *out, uint32_t r) {
+    uint32_t x[16];
+    memcpy(x, in + 16 * (2 * r - 1), sizeof(x));
+    for (uint32_t i = 0; i < 2 * r; i++) {
+        for (int k = 0; k < 16; k++) {
+            x[k] ^= in[16 * i + k];
+        }
+        salsa8Ref(x);
+        memcpy(out + 16 * (i / 2 + (i & 1) * r), x, sizeof(x));
+    }
+}
+
+static void romixRef(uint8_t *B, size_t count, uint32_t r, uint64_t N, uint8_t *work) {
+    size_t words = 32 * (size_t) r;
+    uint32_t *v = (uint32_t *) work;
+    uint32_t *x = v + words * N;
+    uint32_t *y = x + words;
+    for (size_t c = 0; c < count; c++, B += 4 * words) {
+        memcpy(x, B, 4 * words);  // x86 is little-endian, as scrypt is
+        for (uint64_t i = 0; i < N; i++) {
+            memcpy(v + words * i, x, 4 * words);
+            blockMixRef(x, y, r);
+            std::swap(x, y);
+        }
+        for (uint64_t i = 0; i < N; i++) {
+            uint64_t j = x[words - 16] | (uint64_t) x[words - 15] << 32;
+            const uint32_t *ref = v + words * (j & (N - 1));
+            for (size_t k = 0; k < words; k++) {
+                x[k] ^= ref[k];
+            }
+            blockMixRef(x, y, r);
+            std::swap(x, y);
+        }
+        memcpy(B, x, 4 * words);
+    }
+    OPENSSL_cleanse(x, 8 * words);
+}
+
+// Vector kernels: one 128-bit lane group per instance, so a register holds the same row of
+// sizeof(V) / 16 instances. A 64-byte sub-block is stored as four rows in the diagonal order of
+// Percival's SSE2 code, row k lane c holding word (4k + 5c) mod 16, which turns both Salsa20
+// half-rounds into whole-row operations with a lane rotation in between
+// Everything is always_inline so it takes the target of the wrapper that instantiates it
+// Vector types only ever cross always_inline boundaries, so the ABI note does not apply
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+typedef uint32_t v16u32 __attribute__((vector_size(64)));
+
+#define SCRYPT_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// The helpers work in place: a template returning a vector is instantiated at the end of the
+// translation unit, past the pragma pop, and would still be diagnosed
+template <typename V>
+SCRYPT_ALWAYS_INLINE void xorRotl(V &x, const V &t, int n) {
+    x ^= (t << n) | (t >> (32 - n));
+}
+
+// Lane j of each instance takes lane (j + S) mod 4
+#define SCRYPT_LANES(base) base + (S & 3), base + ((S + 1) & 3), base + ((S + 2) & 3), base + ((S + 3) & 3)
+
+template <int S>
+SCRYPT_ALWAYS_INLINE void rotateLanes(v4u32 &x) {
+    x = __builtin_shuffle(x, (v4u32) {SCRYPT_LANES(0)});
+}
+
+template <int S>
+SCRYPT_ALWAYS_INLINE void rotateLanes(v8u32 &x) {
+    x = __builtin_shuffle(x, (v8u32) {SCRYPT_LANES(0), SCRYPT_LANES(4)});
+}
+
+template <int S>
+SCRYPT_ALWAYS_INLINE void rotateLanes(v16u32 &x) {
+    x = __builtin_shuffle(x, (v16u32) {SCRYPT_LANES(0), SCRYPT_LANES(4), SCRYPT_LANES(8), SCRYPT_LANES(12)});
+}
+
+#undef SCRYPT_LANES
+
+// Salsa20 with Rounds rounds, 8 for scrypt; yescrypt's pwxform BlockMix also uses 2
+template <int Rounds, typename V>
+SCRYPT_ALWAYS_INLINE void salsa(V &x0, V &x1, V &x2, V &x3) {
+    V in0 = x0, in1 = x1, in2 = x2, in3 = x3;
+    for (int i = 0; i < Rounds; i += 2) {
+        // Columns
+        xorRotl(x1, x0 + x3, 7);
+        xorRotl(x2, x1 + x0, 9);
+        xorRotl(x3, x2 + x1, 13);
+        xorRotl(x0, x3 + x2, 18);
+        rotateLanes<3>(x1);
+        rotateLanes<2>(x2);
+        rotateLanes<1>(x3);
+        // Rows
+        xorRotl(x3, x0 + x1, 7);
+        xorRotl(x2, x3 + x0, 9);
+        xorRotl(x1, x2 + x3, 13);
+        xorRotl(x0, x1 + x2, 18);
+        rotateLanes<1>(x1);
+        rotateLanes<2>(x2);
+        rotateLanes<3>(x3);
+    }
+    x0 += in0;
+    x1 += in1;
+    x2 += in2;
+    x3 += in3;
+}
+
+// Xors row v of every instance's own V entry into x; ref[l] points at instance l's lane group
+// of its entry
+template <typename V>
+SCRYPT_ALWAYS_INLINE void gather(V &x, const uint8_t *const *ref, size_t v) {
+    V g;
+    for (size_t l = 0; l < sizeof(V) / 16; l++) {
+        memcpy((uint8_t *) &g + 16 * l, ref[l] + v * sizeof(V), 16);
+    }
+    x ^= g;
+}
+
+// BlockMix of in, xored with each instance's V entry first when Xor is set, into out
+template <typename V, bool Xor>
+SCRYPT_ALWAYS_INLINE void blockMix(const V *in, const uint8_t *const *ref, V *out, uint32_t r) {
+    size_t last = 8 * (size_t) r - 4;
+    V x0 = in[last], x1 = in[last + 1], x2 = in[last + 2], x3 = in[last + 3];
+    if (Xor) {
+        gather<V>(x0, ref, last);
+        gather<V>(x1, ref, last + 1);
+        gather<V>(x2, ref, last + 2);
+        gather<V>(x3, ref, last + 3);
+    }
+    for (size_t i = 0; i < 2 * r; i++) {
+        x0 ^= in[4 * i];
+        x1 ^= in[4 * i + 1];
+        x2 ^= in[4 * i + 2];
+        x3 ^= in[4 * i + 3];
+        if (Xor) {
+            gather<V>(x0, ref, 4 * i);
+            gather<V>(x1, ref, 4 * i + 1);
+            gather<V>(x2, ref, 4 * i + 2);
+            gather<V>(x3, ref, 4 * i + 3);
+        }
+        salsa<8>(x0, x1, x2, x3);
+        V *o = out + 4 * (i / 2 + (i & 1) * r);
+        o[0] = x0;
+        o[1] = x1;
+        o[2] = x2;
+        o[3] = x3;
+    }
+}
+
+// Each instance's V entry for the next step: Integerify is word 0 of the last sub-block, which
+// sits in row 0 lane 0, with word 1 above it in row 3 lane 1
+template <typename V>
+SCRYPT_ALWAYS_INLINE void integerify(const V *x, const V *v, uint32_t r, uint64_t N, const uint8_t **ref) {
+    size_t vecs = 8 * (size_t) r;
+    for (size_t l = 0; l < sizeof(V) / 16; l++) {
+        uint64_t j = x[vecs - 4][4 * l] | (uint64_t) x[vecs - 1][4 * l + 1] << 32;
+        ref[l] = (const uint8_t *) (v + vecs * (j & (N - 1))) + 16 * l;
+    }
+}
+
+// sizeof(V) / 16 instances of ROMix side by side; V entries are stored whole, all instances
+// interleaved, since every instance writes entry i at step i
+template <typename V>
+SCRYPT_ALWAYS_INLINE void romixLanes(uint8_t *B, uint32_t r, uint64_t N, uint8_t *work) {
+    const size_t lanes = sizeof(V) / 16;
+    size_t vecs = 8 * (size_t) r;
+    V *v = (V *) work;
+    V *x = v + vecs * N;
+    V *y = x + vecs;
+    for (size_t l = 0; l < lanes; l++) {
+        for (size_t s = 0; s < 2 * r; s++) {
+            const uint8_t *src = B + 128 * r * l + 64 * s;
+            for (int k = 0; k < 4; k++) {
+                for (int c = 0; c < 4; c++) {
+                    uint32_t w;
+                    memcpy(&w, src + 4 * ((4 * k + 5 * c) & 15), 4);
+                    x[4 * s + k][4 * l + c] = w;
+                }
+            }
+        }
+    }
+    // N is even, so the two buffers take turns without a copy
+    for (uint64_t i = 0; i < N; i += 2) {
+        memcpy(v + vecs * i, x, vecs * sizeof(V));
+        blockMix<V, false>(x, NULL, y, r);
+        memcpy(v + vecs * (i + 1), y, vecs * sizeof(V));
+        blockMix<V, false>(y, NULL, x, r);
+    }
+    const uint8_t *ref[lanes];
+    for (uint64_t i = 0; i < N; i += 2) {
+        integerify(x, v, r, N, ref);
+        blockMix<V, true>(x, ref, y, r);
+        integerify(y, v, r, N, ref);
+        blockMix<V, true>(y, ref, x, r);
+    }
+    for (size_t l = 0; l < lanes; l++) {
+        for (size_t s = 0; s < 2 * r; s++) {
+            uint8_t *dst = B + 128 * r * l + 64 * s;
+            for (int k = 0; k < 4; k++) {
+                for (int c = 0; c < 4; c++) {
+                    uint32_t w = x[4 * s + k][4 * l + c];
+                    memcpy(dst + 4 * ((4 * k + 5 * c) & 15), &w, 4);
+                }
+            }
+        }
+    }
+    OPENSSL_cleanse(x, 2 * vecs * sizeof(V));
+}
+
+#undef SCRYPT_ALWAYS_INLINE
+
+#pragma GCC diagnostic pop
+
+// SSE2 is the x86-64 baseline; the attribute only keeps the kernels alike
+__attribute__((target("sse2")))
+static void romixSse2(uint8_t *B, size_t count, uint32_t r, uint64_t N, uint8_t *work) {
+    for (; count > 0; count--, B += 128 * r) {
+        romixLanes<v4u32>(B, r, N, work);
+    }
+}
+
+// Two instances per register; an odd one left over runs alone
+__attribute__((target("avx2")))
+static void romixAvx2(uint8_t *B, size_t count, uint32_t r, uint64_t N, uint8_t *work) {
+    for (; count >= 2; count -= 2, B += 256 * r) {
+        romixLanes<v8u32>(B, r, N, work);
+    }
+    if (count > 0) {
+        romixLanes<v4u32>(B, r, N, work);
+    }
+}
+
+// Four instances per register; the rest two and one at a time
+__attribute__((target("avx512f")))
+static void romixAvx512(uint8_t *B, size_t count, uint32_t r, uint64_t N, uint8_t *work) {
+    for (; count >= 4; count -= 4, B += 512 * r) {
+        romixLanes<v16u32>(B, r, N, work);
+    }
+    if (count >= 2) {
+        romixLanes<v8u32>(B, r, N, work);
+        count -= 2;
+        B += 256 * r;
+    }
+    if (count > 0) {
+        romixLanes<v4u32>(B, r, N, work);
+    }
+}
+
+inline Romix kernel(Isa isa) {
+    switch (isa) {
+        case REF: return romixRef;
+        case SSE2: return romixSse2;
+        case AVX2: return romixAvx2;
+        case AVX512: return romixAvx512;
+    }
+    return romixRef;
+}
+
+// Instances go to min(threads, p) workers in contiguous shares; each worker has a work region
+// for as many instances as its kernel runs at once
+struct Layout {
+    uint32_t workers;
+    size_t slotBytes;   // One worker's region
+    size_t bytes;       // All of them, the size passed to allocate
+};
+
+// False if N is not a power of two above 1, r or p is 0, r * p reaches 2^30, or the memory does
+// not fit in size_t; the same limits libxcrypt's $7$ enforces
+inline bool layout(uint64_t N, uint32_t r, uint32_t p, unsigned int threads, Isa isa, Layout &out) {
+    if (N < 2 || (N & (N - 1)) != 0 || r == 0 || p == 0 || (uint64_t) r * p >= ((uint64_t) 1 << 30)) {
+        return false;
+    }
+    out.workers = std::max(1u, std::min(threads, p));
+    size_t share = (p + out.workers - 1) / out.workers;
+    size_t slot = std::min(share, width(isa));
+    size_t entries;
+    if (__builtin_add_overflow(N, 2, &entries) || __builtin_mul_overflow(entries, (size_t) 128 * r, &out.slotBytes)
+            || __builtin_mul_overflow(out.slotBytes, slot, &out.slotBytes)
+            || __builtin_mul_overflow(out.slotBytes, (size_t) out.workers, &out.bytes)) {
+        return false;
+    }
+    return true;
+}
+
+// Working memory derive allocates for these parameters, 0 if they are invalid
+inline size_t memoryBytes(uint64_t N, uint32_t r, uint32_t p, unsigned int threads, Isa isa) {
+    Layout l;
+    return layout(N, r, p, threads, isa, l) ? l.bytes : 0;
+}
+
+// scrypt(password, salt, N, r, p) into outLen bytes of out
+// The work regions come from allocate and go back to deallocate on this thread, or from
+// posix_memalign when allocate is NULL; B and the X/Y buffers are wiped, V is not, as in libxcrypt
+inline int derive(const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+        uint64_t N, uint32_t r, uint32_t p, unsigned int threads, Isa isa,
+        AllocateCallback allocate, FreeCallback deallocate, uint8_t *out, size_t outLen) {
+    Layout l;
+    if (!layout(N, r, p, threads, isa, l) || passwordLen > INT32_MAX || saltLen > INT32_MAX || outLen > INT32_MAX) {
+        return INVALID_PARAMETERS;
+    }
+    size_t blockBytes = (size_t) 128 * r;
+    size_t bBytes = blockBytes * p;
+    uint8_t *B = (uint8_t *) malloc(bBytes);
+    if (B == NULL) {
+        return MEMORY_ALLOCATION_ERROR;
+    }
+    uint8_t *work = NULL;
+    if (allocate != NULL) {
+        if (allocate(&work, l.bytes) != OK) {
+            work = NULL;
+        }
+    } else if (posix_memalign((void **) &work, 64, l.bytes) != 0) {
+        work = NULL;
+    }
+    if (work == NULL) {
+        free(B);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    PKCS5_PBKDF2_HMAC((const char *) password, passwordLen, salt, saltLen, 1, EVP_sha256(), bBytes, B);
+    Romix romix = kernel(isa);
+    auto run = [&](uint32_t w) {
+        size_t first = (size_t) p * w / l.workers;
+        size_t last = (size_t) p * (w + 1) / l.workers;
+        romix(B + blockBytes * first, last - first, r, N, work + l.slotBytes * w);
+    };
+    std::vector<std::thread> workers;
+    for (uint32_t w = 1; w < l.workers; w++) {
+        workers.emplace_back(run, w);
+    }
+    run(0);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    PKCS5_PBKDF2_HMAC((const char *) password, passwordLen, B, bBytes, 1, EVP_sha256(), outLen, out);
+
+    OPENSSL_cleanse(B, bBytes);
+    free(B);
+    if (deallocate != NULL) {
+        deallocate(work, l.bytes);
+    } else {
+        free(work);
+    }
+    return OK;
+}
+
+}  // namespace scrypt_core
+
+#endif // SCRYPT_CORE_HPP
@@ -0,0 +1,305 @@
+#ifndef SHA256_MB_HPP
+#define SHA256_MB_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+#include <cpuid.h>
+#include <immintrin.h>
+
+// Multi-buffer SHA-256: hashes several independent messages at once, one message per SIMD lane
+// The round function is written once against GCC vector extensions and instantiated per ISA
+// inside functions carrying a target attribute, so the binary runs on any x86-64 host and
+// picks the widest kernel the CPU supports at runtime
+namespace sha256_mb {
+
+// Vector types only ever cross always_inline boundaries, so the ABI note does not apply
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+enum Isa { SCALAR, SSE2, AVX2, AVX512, SHANI };
+static const Isa allIsas[] = {SCALAR, SSE2, AVX2, AVX512, SHANI};
+
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+typedef uint32_t v16u32 __attribute__((vector_size(64)));
+
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+alignas(16) static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline const char *isaName(Isa isa) {
+    switch (isa) {
+        case SCALAR: return "scalar";
+        case SSE2: return "sse2";
+        case AVX2: return "avx2";
+        case AVX512: return "avx512";
+        case SHANI: return "sha-ni";
+    }
+    return "unknown";
+}
+
+// Messages processed per call of the compression kernel
+inline size_t lanes(Isa isa) {
+    switch (isa) {
+        case SSE2: return 4;
+        case AVX2: return 8;
+        case AVX512: return 16;
+        default: return 1;
+    }
+}
+
+inline bool isaSupported(Isa isa) {
+    __builtin_cpu_init();
+    switch (isa) {
+        case SCALAR: return true;
+        case SSE2: return __builtin_cpu_supports("sse2");
+        case AVX2: return __builtin_cpu_supports("avx2");
+        case AVX512: return __builtin_cpu_supports("avx512f");
+        case SHANI: {
+            unsigned int eax, ebx, ecx, edx;
+            if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+                return false;
+            }
+            return (ebx & (1 << 29)) && __builtin_cpu_supports("sse4.1");
+        }
+    }
+    return false;
+}
+
+// Sixteen AVX-512 lanes outrun SHA-NI on one message at a time, but SHA-NI beats eight AVX2
+// lanes, which is the best most AMD hosts have
+inline Isa bestIsa() {
+    for (Isa isa : {AVX512, SHANI, AVX2, SSE2}) {
+        if (isaSupported(isa)) {
+            return isa;
+        }
+    }
+    return SCALAR;
+}
+
+// A macro rather than a template: templates are instantiated at the end of the translation unit,
+// past the pragma pop, where a vector return would still be diagnosed
+#define SHA256_MB_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// One SHA-256 compression on every lane of V; state and block are stored word-major
+template<class V>
+static inline __attribute__((always_inline)) void compress(V *state, const V *block) {
+    V w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = block[i];
+    }
+    V a = state[0], b = state[1], c = state[2], d = state[3];
+    V e = state[4], f = state[5], g = state[6], h = state[7];
+    #pragma GCC unroll 64
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16) {
+            V w15 = w[(i - 15) & 15], w2 = w[(i - 2) & 15];
+            V s0 = SHA256_MB_ROTR(w15, 7) ^ SHA256_MB_ROTR(w15, 18) ^ (w15 >> 3);
+            V s1 = SHA256_MB_ROTR(w2, 17) ^ SHA256_MB_ROTR(w2, 19) ^ (w2 >> 10);
+            w[i & 15] += s0 + w[(i - 7) & 15] + s1;
+        }
+        V t1 = h + (SHA256_MB_ROTR(e, 6) ^ SHA256_MB_ROTR(e, 11) ^ SHA256_MB_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i & 15];
+        V t2 = (SHA256_MB_ROTR(a, 2) ^ SHA256_MB_ROTR(a, 13) ^ SHA256_MB_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+// Number of 64-byte blocks in the padded message
+static inline size_t blockCount(size_t len) {
+    return (len + 9 + 63) / 64;
+}
+
+// Write block index b of the padded message into blk
+static inline void fillBlock(std::string_view msg, size_t b, unsigned char *blk) {
+    size_t off = b * 64;
+    size_t take = off < msg.size() ? std::min<size_t>(64, msg.size() - off) : 0;
+    memcpy(blk, msg.data() + off, take);
+    memset(blk + take, 0, 64 - take);
+    if (msg.size() >= off && msg.size() - off < 64) {
+        blk[msg.size() - off] = 0x80;
+    }
+    if (b == blockCount(msg.size()) - 1) {
+        uint64_t bits = (uint64_t) msg.size() * 8;
+        for (int i = 0; i < 8; i++) {
+            blk[63 - i] = (unsigned char) (bits >> (8 * i));
+        }
+    }
+}
+
+static inline uint32_t load32be(const unsigned char *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void store32be(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+// Hash messages L at a time; lanes that run out of blocks early keep their state through a mask
+template<class V, size_t L>
+static inline __attribute__((always_inline)) void hashLanes(const std::string_view *msgs, size_t n, unsigned char *out) {
+    for (size_t base = 0; base < n; base += L) {
+        size_t count = std::min(L, n - base);
+        size_t blocks[L];
+        size_t maxBlocks = 0;
+        for (size_t l = 0; l < L; l++) {
+            blocks[l] = l < count ? blockCount(msgs[base + l].size()) : 0;
+            maxBlocks = std::max(maxBlocks, blocks[l]);
+        }
+        V state[8];
+        for (int i = 0; i < 8; i++) {
+            state[i] = V{} + IV[i];
+        }
+        for (size_t b = 0; b < maxBlocks; b++) {
+            alignas(64) uint32_t words[16][L];
+            alignas(64) uint32_t active[L];
+            unsigned char blk[64];
+            for (size_t l = 0; l < L; l++) {
+                active[l] = b < blocks[l] ? 0xffffffff : 0;
+                if (active[l]) {
+                    fillBlock(msgs[base + l], b, blk);
+                } else {
+                    memset(blk, 0, 64);
+                }
+                for (int i = 0; i < 16; i++) {
+                    words[i][l] = load32be(blk + 4 * i);
+                }
+            }
+            V w[16], next[8], mask;
+            memcpy(&mask, active, sizeof(V));
+            for (int i = 0; i < 16; i++) {
+                memcpy(&w[i], words[i], sizeof(V));
+            }
+            for (int i = 0; i < 8; i++) {
+                next[i] = state[i];
+            }
+            compress(next, w);
+            for (int i = 0; i < 8; i++) {
+                state[i] = (next[i] & mask) | (state[i] & ~mask);
+            }
+        }
+        alignas(64) uint32_t digest[8][L];
+        for (int i = 0; i < 8; i++) {
+            memcpy(digest[i], &state[i], sizeof(V));
+        }
+        for (size_t l = 0; l < count; l++) {
+            for (int i = 0; i < 8; i++) {
+                store32be(out + 32 * (base + l) + 4 * i, digest[i][l]);
+            }
+        }
+    }
+}
+
+static void hashScalar(const std::string_view *msgs, size_t n, unsigned char *out) {
+    hashLanes<uint32_t, 1>(msgs, n, out);
+}
+
+__attribute__((target("sse2")))
+static void hashSse2(const std::string_view *msgs, size_t n, unsigned char *out) {
+    hashLanes<v4u32, 4>(msgs, n, out);
+}
+
+__attribute__((target("avx2")))
+static void hashAvx2(const std::string_view *msgs, size_t n, unsigned char *out) {
+    hashLanes<v8u32, 8>(msgs, n, out);
+}
+
+__attribute__((target("avx512f")))
+static void hashAvx512(const std::string_view *msgs, size_t n, unsigned char *out) {
+    hashLanes<v16u32, 16>(msgs, n, out);
+}
+
+// SHA-NI compression of one block; state is in the usual a..h order
+// The block is either 64 message bytes or, with Words, 16 already-decoded message words
+// sha256rnds2 has no VEX form, so when the build itself targets AVX the upper vector state is
+// cleared first; otherwise every SHA instruction stalls on an SSE/AVX transition
+template<bool Words>
+__attribute__((target("sha,sse4.1")))
+static inline void compressShani(uint32_t *state, const void *blk) {
+#ifdef __AVX__
+    _mm256_zeroupper();
+#endif
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1);  // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b);  // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);  // CDGH
+    __m128i abefSave = state0, cdghSave = state1;
+
+    __m128i w[16];
+    #pragma GCC unroll 16
+    for (int i = 0; i < 16; i++) {
+        if (i < 4) {
+            w[i] = _mm_loadu_si128((const __m128i *) blk + i);
+            if (!Words) {
+                w[i] = _mm_shuffle_epi8(w[i], bswap);
+            }
+        } else {
+            w[i] = _mm_sha256msg1_epu32(w[i - 4], w[i - 3]);
+            w[i] = _mm_add_epi32(w[i], _mm_alignr_epi8(w[i - 1], w[i - 2], 4));
+            w[i] = _mm_sha256msg2_epu32(w[i], w[i - 1]);
+        }
+        __m128i msg = _mm_add_epi32(w[i], _mm_load_si128((const __m128i *) &K[4 * i]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+    }
+
+    state0 = _mm_add_epi32(state0, abefSave);
+    state1 = _mm_add_epi32(state1, cdghSave);
+    tmp = _mm_shuffle_epi32(state0, 0x1b);  // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1);  // DCHG
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xf0));  // DCBA
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8));  // HGFE
+}
+
+__attribute__((target("sha,sse4.1")))
+static void hashShani(const std::string_view *msgs, size_t n, unsigned char *out) {
+    unsigned char blk[64];
+    for (size_t m = 0; m < n; m++) {
+        uint32_t state[8];
+        memcpy(state, IV, sizeof(state));
+        size_t blocks = blockCount(msgs[m].size());
+        for (size_t b = 0; b < blocks; b++) {
+            fillBlock(msgs[m], b, blk);
+            compressShani<false>(state, blk);
+        }
+        for (int i = 0; i < 8; i++) {
+            store32be(out + 32 * m + 4 * i, state[i]);
+        }
+    }
+}
+
+// Hash n messages with the given kernel, writing 32 bytes per message into out
+// The caller must check isaSupported(isa) first
+inline void hash(const std::string_view *msgs, size_t n, unsigned char *out, Isa isa) {
+    switch (isa) {
+        case SCALAR: hashScalar(msgs, n, out); break;
+        case SSE2: hashSse2(msgs, n, out); break;
+        case AVX2: hashAvx2(msgs, n, out); break;
+        case AVX512: hashAvx512(msgs, n, out); break;
+        case SHANI: hashShani(msgs, n, out); break;
+    }
+}
+
+#undef SHA256_MB_ROTR
+
+#pragma GCC diagnostic pop
+
+}  // namespace sha256_mb
+
+#endif // SHA256_MB_HPP
@@ -0,0 +1,161 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <ostream>
+#include <vector>
+#include <ctime>
+#include "perfcounters.hpp"
+
+// One timed pass: wall time, CPU time of the calling thread and CPU time of the whole process
+// Process CPU includes helper threads such as Argon2's lanes, so it is the core-seconds cost
+struct Sample {
+    double wall;
+    double threadCpu;
+    double processCpu;
+};
+
+class Stopwatch {
+    private:
+        std::chrono::steady_clock::time_point wallStart;
+        double threadStart = 0;
+        double processStart = 0;
+
+        static double cpuSeconds(clockid_t clock) {
+            struct timespec ts;
+            clock_gettime(clock, &ts);
+            return ts.tv_sec + ts.tv_nsec * 1e-9;
+        }
+
+    public:
+        void start() {
+            threadStart = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+            processStart = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+            wallStart = std::chrono::steady_clock::now();
+        }
+
+        Sample stop() {
+            auto wallEnd = std::chrono::steady_clock::now();
+            return {
+                std::chrono::duration<double>(wallEnd - wallStart).count(),
+                cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - threadStart,
+                cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - processStart,
+            };
+        }
+};
+
+// Descriptive statistics of repeated samples
+// The confidence interval is the 95% Student-t interval of the mean; outliers fall outside
+// Tukey's fences, 1.5 interquartile ranges beyond the quartiles
+struct Summary {
+    size_t n = 0;
+    double mean = 0, median = 0, stddev = 0;
+    double ciLow = 0, ciHigh = 0;
+    double min = 0, max = 0;
+    size_t outliers = 0;
+
+    // Linear interpolation between closest ranks of sorted values
+    static double quantile(const std::vector<double> &sorted, double q) {
+        double pos = q * (sorted.size() - 1);
+        size_t lo = (size_t) pos;
+        size_t hi = std::min(lo + 1, sorted.size() - 1);
+        return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+    }
+
+    // Two-sided 95% critical value of Student's t with df degrees of freedom
+    static double tCritical(size_t df) {
+        static const double table[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+        };
+        return df == 0 ? 0 : df <= 30 ? table[df - 1] : 1.96;
+    }
+
+    static Summary of(std::vector<double> values) {
+        Summary s;
+        s.n = values.size();
+        if (s.n == 0) {
+            return s;
+        }
+        std::sort(values.begin(), values.end());
+        s.min = values.front();
+        s.max = values.back();
+        s.median = quantile(values, 0.5);
+        for (double v : values) {
+            s.mean += v;
+        }
+        s.mean /= s.n;
+        if (s.n > 1) {
+            double sq = 0;
+            for (double v : values) {
+                sq += (v - s.mean) * (v - s.mean);
+            }
+            s.stddev = std::sqrt(sq / (s.n - 1));
+        }
+        double half = tCritical(s.n - 1) * s.stddev / std::sqrt((double) s.n);
+        s.ciLow = s.mean - half;
+        s.ciHigh = s.mean + half;
+        double q1 = quantile(values, 0.25), q3 = quantile(values, 0.75);
+        double lowFence = q1 - 1.5 * (q3 - q1), highFence = q3 + 1.5 * (q3 - q1);
+        for (double v : values) {
+            s.outliers += v < lowFence || v > highFence;
+        }
+        return s;
+    }
+};
+
+// How a measurement repeats its pass: warmup passes run first and are discarded, so page faults,
+// cold caches and lazy library setup left by earlier tests do not land in the samples
+struct HarnessConfig {
+    unsigned int warmup = 1;
+    unsigned int repetitions = 5;
+};
+
+struct Measurement {
+    std::vector<Sample> samples;
+    Summary wall, threadCpu, processCpu;
+    PerfCounts counters;  // Summed over the timed passes
+
+    // Time is the median wall time, so the first column reads like the single-pass csvs
+    static const char *csvHeader() {
+        return "Time,Mean,Stddev,CI95Low,CI95High,Min,Max,Outliers,Reps,ThreadCpu,ProcessCpu,CpuPerWall";
+    }
+
+    void writeCsv(std::ostream &f) const {
+        f << wall.median << "," << wall.mean << "," << wall.stddev << "," << wall.ciLow << "," << wall.ciHigh << ","
+          << wall.min << "," << wall.max << "," << wall.outliers << "," << wall.n << ","
+          << threadCpu.median << "," << processCpu.median << "," << processCpu.median / wall.median;
+    }
+};
+
+// Each pass runs hashes hashes, for the per-hash counter columns
+inline Measurement measure(const std::function<void()> &pass, uint64_t hashes, const HarnessConfig &config) {
+    for (unsigned int i = 0; i < config.warmup; i++) {
+        pass();
+    }
+    Measurement m;
+    std::vector<double> wall, threadCpu, processCpu;
+    Stopwatch watch;
+    for (unsigned int i = 0; i < config.repetitions; i++) {
+        PerfGroup perf;
+        perf.start();
+        watch.start();
+        pass();
+        Sample sample = watch.stop();
+        m.counters += perf.stop(hashes);
+        m.samples.push_back(sample);
+        wall.push_back(sample.wall);
+        threadCpu.push_back(sample.threadCpu);
+        processCpu.push_back(sample.processCpu);
+    }
+    m.wall = Summary::of(wall);
+    m.threadCpu = Summary::of(threadCpu);
+    m.processCpu = Summary::of(processCpu);
+    return m;
+}
+
+#endif // STATS_HPP
\ No newline at end of file
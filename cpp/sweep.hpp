@@ -0,0 +1,298 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <sched.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "cgroup.hpp"
+
+// One configuration of a sweep: run writes its csv row, and the scheduler appends the row plus the
+// kernel's accounting for the run to csv
+struct SweepJob {
+    std::string csv;
+    size_t memory = 0;          // Working memory of the hash itself, which decides if the job is heavy
+    size_t overhead = 0;        // Process, corpus and library bytes on top, counted for the budget only
+    unsigned int threads = 1;   // Cores it keeps busy at once
+    bool exclusive = false;     // Latency-sensitive: nothing else runs alongside it
+    std::function<void(std::ostream &)> run;
+};
+
+// Append a run's row and its accounting to a csv, as every isolated configuration does
+inline void appendIsolatedRow(const std::string &csv, const std::string &row, const CgroupUsage &usage) {
+    if (usage.memoryPeak >= 0) {
+        std::cout << "  memory.peak " << usage.memoryPeak / 1024 << " KiB" << (usage.hugetlbCharged ? " including hugetlb" : "") << std::endl;
+    } else {
+        std::cout << "  max RSS " << usage.maxRss << " KiB (no memory controller)" << std::endl;
+    }
+    std::ofstream f(csv, std::ios_base::app);
+    f << row << ",";
+    usage.writeCsv(f);
+    f << std::endl;
+    f.close();
+}
+
+// Runs queued jobs in parallel on worker processes forked once per sweep, one per core
+// Each job gets its own cores (pinned), its own cgroup and a fresh child of its worker, so accounting
+// and heap state never carry over between jobs; results come back to this process over pipes
+// Packing rules, in declaration order with backfill:
+// - running jobs never need more cores or memory than the budget
+// - at most one heavy job (hash memory at least heavyBytes) runs at a time, so two never fight
+//   over memory bandwidth; jobs with small working sets such as PBKDF2 pack freely around it
+// - an exclusive job, or one over the whole memory budget, waits for everything before it to finish
+//   and holds back everything after it
+// Rows are appended in declaration order, each as soon as every job before it is done
+class SweepScheduler {
+    private:
+        struct Command {
+            uint32_t job;
+            cpu_set_t cpus;
+        };
+
+        struct Result {
+            uint32_t job;
+            CgroupUsage usage;
+            uint64_t length;
+        };
+
+        struct Worker {
+            pid_t pid = -1;
+            int command = -1;
+            int result = -1;
+            bool busy = false;
+            uint32_t job = 0;
+            std::vector<unsigned int> cpus;
+        };
+
+        static const uint32_t stop = UINT32_MAX;
+        std::vector<SweepJob> jobs;
+
+        static bool writeAll(int fd, const void *data, size_t size) {
+            for (size_t done = 0; done < size; ) {
+                ssize_t n = write(fd, (const char *) data + done, size - done);
+                if (n < 0 && errno != EINTR) {
+                    return false;
+                }
+                done += n > 0 ? n : 0;
+            }
+            return true;
+        }
+
+        static bool readAll(int fd, void *data, size_t size) {
+            for (size_t done = 0; done < size; ) {
+                ssize_t n = read(fd, (char *) data + done, size - done);
+                if (n == 0 || (n < 0 && errno != EINTR)) {
+                    return false;
+                }
+                done += n > 0 ? n : 0;
+            }
+            return true;
+        }
+
+        // Worker process: take jobs until told to stop, each in its own child and cgroup
+        void workerLoop(int command, int result) {
+            Command cmd;
+            while (readAll(command, &cmd, sizeof(cmd)) && cmd.job != stop) {
+                const SweepJob &job = jobs[cmd.job];
+                Result res = {cmd.job, CgroupUsage(), 0};
+                std::string row = CgroupRunner::instance().run([&](std::ostream &out) {
+                    sched_setaffinity(0, sizeof(cmd.cpus), &cmd.cpus);
+                    job.run(out);
+                }, res.usage);
+                res.length = row.size();
+                if (!writeAll(result, &res, sizeof(res)) || !writeAll(result, row.data(), row.size())) {
+                    break;
+                }
+            }
+            _exit(0);
+        }
+
+    public:
+        static size_t availableMemory() {
+            std::ifstream meminfo("/proc/meminfo");
+            std::string key;
+            size_t value;
+            while (meminfo >> key >> value) {
+                if (key == "MemAvailable:") {
+                    return value * 1024;
+                }
+                meminfo.ignore(256, '\n');
+            }
+            return 0;
+        }
+
+        size_t memoryBudget;
+        unsigned int cores;
+        size_t heavyBytes = (size_t) 32 << 20;
+
+        // Defaults: every core, and 80% of the memory available now
+        SweepScheduler() : memoryBudget(availableMemory() / 5 * 4), cores(std::max(1u, std::thread::hardware_concurrency())) {}
+
+        void add(SweepJob job) {
+            jobs.push_back(std::move(job));
+        }
+
+        size_t size() const {
+            return jobs.size();
+        }
+
+        // Run every queued job and append its row; the queue is empty afterwards
+        void run() {
+            if (jobs.empty()) {
+                return;
+            }
+            // Controllers are set up here once, not in every worker
+            CgroupRunner::instance();
+            std::cout.flush();
+            std::vector<Worker> workers(std::min((size_t) cores, jobs.size()));
+            for (Worker &worker : workers) {
+                int command[2], result[2];
+                assert(pipe(command) == 0 && pipe(result) == 0);
+                worker.pid = fork();
+                assert(worker.pid >= 0);
+                if (worker.pid == 0) {
+                    close(command[1]);
+                    close(result[0]);
+                    // Pipes of workers forked earlier stay open here otherwise, and their EOFs never come
+                    for (Worker &other : workers) {
+                        if (other.pid > 0) {
+                            close(other.command);
+                            close(other.result);
+                        }
+                    }
+                    workerLoop(command[0], result[1]);
+                }
+                close(command[0]);
+                close(result[1]);
+                worker.command = command[1];
+                worker.result = result[0];
+            }
+
+            std::vector<bool> freeCores(cores, true);
+            std::vector<bool> done(jobs.size(), false);
+            std::vector<std::string> rows(jobs.size());
+            std::vector<CgroupUsage> usages(jobs.size());
+            std::vector<uint32_t> pending;
+            for (uint32_t i = 0; i < jobs.size(); i++) {
+                pending.push_back(i);
+            }
+            unsigned int usedCores = 0, running = 0, heavyRunning = 0;
+            size_t usedMemory = 0, flushed = 0;
+            bool exclusiveRunning = false;
+            auto footprint = [](const SweepJob &job) {
+                return job.memory + job.overhead;
+            };
+            auto isExclusive = [&](const SweepJob &job) {
+                return job.exclusive || footprint(job) > memoryBudget;
+            };
+            auto coresFor = [&](const SweepJob &job) {
+                return isExclusive(job) ? cores : std::max(1u, std::min(job.threads, cores));
+            };
+
+            while (flushed < jobs.size()) {
+                for (size_t p = 0; p < pending.size() && !exclusiveRunning; ) {
+                    const SweepJob &job = jobs[pending[p]];
+                    bool exclusive = isExclusive(job);
+                    bool heavy = job.memory >= heavyBytes;
+                    unsigned int need = coresFor(job);
+                    if (exclusive && running > 0) {
+                        break;
+                    }
+                    auto idle = std::find_if(workers.begin(), workers.end(), [](const Worker &w) { return !w.busy; });
+                    if (idle == workers.end()) {
+                        break;
+                    }
+                    if (!exclusive && (usedCores + need > cores || usedMemory + footprint(job) > memoryBudget || (heavy && heavyRunning > 0))) {
+                        p++;
+                        continue;
+                    }
+                    Command cmd;
+                    cmd.job = pending[p];
+                    CPU_ZERO(&cmd.cpus);
+                    idle->cpus.clear();
+                    for (unsigned int c = 0; c < cores && idle->cpus.size() < need; c++) {
+                        if (freeCores[c]) {
+                            freeCores[c] = false;
+                            idle->cpus.push_back(c);
+                            CPU_SET(c, &cmd.cpus);
+                        }
+                    }
+                    assert(writeAll(idle->command, &cmd, sizeof(cmd)));
+                    idle->busy = true;
+                    idle->job = cmd.job;
+                    usedCores += need;
+                    usedMemory += exclusive ? 0 : footprint(job);
+                    heavyRunning += heavy;
+                    exclusiveRunning = exclusive;
+                    running++;
+                    pending.erase(pending.begin() + p);
+                }
+
+                std::vector<struct pollfd> fds;
+                std::vector<Worker *> polled;
+                for (Worker &worker : workers) {
+                    if (worker.busy) {
+                        fds.push_back({worker.result, POLLIN, 0});
+                        polled.push_back(&worker);
+                    }
+                }
+                assert(!fds.empty());
+                while (poll(fds.data(), fds.size(), -1) < 0) {
+                    assert(errno == EINTR);
+                }
+                for (size_t i = 0; i < fds.size(); i++) {
+                    if (fds[i].revents == 0) {
+                        continue;
+                    }
+                    Worker &worker = *polled[i];
+                    Result res;
+                    assert(readAll(worker.result, &res, sizeof(res)) && res.job == worker.job);
+                    std::string row(res.length, '\0');
+                    assert(readAll(worker.result, &row[0], res.length));
+                    const SweepJob &job = jobs[res.job];
+                    rows[res.job] = row;
+                    usages[res.job] = res.usage;
+                    done[res.job] = true;
+                    for (unsigned int c : worker.cpus) {
+                        freeCores[c] = true;
+                    }
+                    usedCores -= coresFor(job);
+                    usedMemory -= isExclusive(job) ? 0 : footprint(job);
+                    heavyRunning -= job.memory >= heavyBytes;
+                    exclusiveRunning = false;
+                    running--;
+                    worker.busy = false;
+                }
+                for (; flushed < jobs.size() && done[flushed]; flushed++) {
+                    // A configuration that writes nothing adds no row
+                    if (!rows[flushed].empty()) {
+                        appendIsolatedRow(jobs[flushed].csv, rows[flushed], usages[flushed]);
+                    }
+                }
+            }
+
+            for (Worker &worker : workers) {
+                Command cmd;
+                cmd.job = stop;
+                writeAll(worker.command, &cmd, sizeof(cmd));
+                close(worker.command);
+                close(worker.result);
+                while (waitpid(worker.pid, NULL, 0) < 0 && errno == EINTR) {}
+            }
+            jobs.clear();
+        }
+};
+
+#endif // SWEEP_HPP
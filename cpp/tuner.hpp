@@ -0,0 +1,227 @@
+#ifndef TUNER_HPP
+#define TUNER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <cassert>
+#include "framework.hpp"
+
+// What a tuned configuration may cost: p99 _hash latency while concurrency hashes run at once,
+// and the working memory of one hash
+struct TuneBudget {
+    double p99Latency = 0.25;
+    size_t memoryBytes = (size_t) 256 << 20;
+    unsigned int concurrency = 1;
+    size_t samples = 8;  // Timed hashes per thread for each candidate, after one warmup hash
+};
+
+// Measured cost of one candidate under the budget's concurrency, latencies in seconds
+struct TuneMeasurement {
+    double p50 = 0;
+    double p99 = 0;
+    double cpuPerHash = 0;  // Process CPU seconds per hash, so lanes and helper threads count
+    size_t memory = 0;
+    bool fits = false;
+};
+
+// One knob of a search: values lo..hi, or 2^lo..2^hi when exponent is set
+// The search stops once the bracket around the boundary is within relTol of its lower end
+struct TuneAxis {
+    const char *name;
+    uint64_t lo;
+    uint64_t hi;
+    double relTol;
+    bool exponent;
+
+    uint64_t value(uint64_t x) const {
+        return exponent ? (uint64_t) 1 << x : x;
+    }
+};
+
+// An algorithm's parameter space: a memory-like knob that is maximised first, then a time-like knob
+// that is maximised with memory fixed, as RFC 9106 recommends for Argon2
+// make builds the algorithm for the two knob values; an axis with lo == hi is not searched
+struct TuneSpace {
+    std::string algorithm;
+    TuneAxis memory;
+    TuneAxis time;
+    std::function<HashBenchmark *(uint64_t memory, uint64_t time)> make;
+};
+
+struct TuneResult {
+    std::string algorithm;
+    bool found = false;
+    uint64_t memory = 0;   // Knob values, not axis positions
+    uint64_t time = 0;
+    double strength = 0;   // Working memory (or 1 byte if none) times the time knob
+    TuneMeasurement cost;
+    size_t evaluations = 0;
+};
+
+// Searches each space for the strongest configuration inside a budget on this host
+// Latency is monotone in both knobs, so each axis is bracketed by doubling from a guess and then
+// bisected, instead of walking a grid; every candidate measured is kept for the trial log
+class ParameterTuner {
+    private:
+        TuneBudget budget;
+        std::vector<std::string> passwords;
+
+        struct Trial {
+            std::string algorithm;
+            uint64_t memory;
+            uint64_t time;
+            TuneMeasurement cost;
+        };
+        std::vector<Trial> trials;
+
+        // Largest x in [lo, hi] for which fits holds, given that fits(lo) holds and fits is monotone
+        static uint64_t largestFitting(uint64_t lo, uint64_t hi, uint64_t guess, double relTol, const std::function<bool(uint64_t)> &fits) {
+            uint64_t fail = hi + 1;
+            guess = std::max(lo, std::min(hi, guess));
+            if (guess > lo) {
+                if (fits(guess)) {
+                    lo = guess;
+                } else {
+                    fail = guess;
+                }
+            }
+            while (fail == hi + 1 && lo < hi) {
+                uint64_t next = std::min(hi, std::max(lo + 1, 2 * lo));
+                if (fits(next)) {
+                    lo = next;
+                } else {
+                    fail = next;
+                }
+            }
+            while (fail - lo > std::max((uint64_t) 1, (uint64_t) (lo * relTol))) {
+                uint64_t mid = lo + (fail - lo) / 2;
+                if (fits(mid)) {
+                    lo = mid;
+                } else {
+                    fail = mid;
+                }
+            }
+            return lo;
+        }
+
+    public:
+        ParameterTuner(const TuneBudget &budget, const std::string &passwordFile) : budget(budget) {
+            const Corpus &corpus = Corpus::load(passwordFile);
+            for (size_t i = 0; i < corpus.size(); i++) {
+                passwords.emplace_back(corpus[i]);
+            }
+        }
+
+        // Hash on budget.concurrency threads at once and take latency percentiles over all of them
+        // Candidates over the memory budget are rejected without running
+        TuneMeasurement measure(HashBenchmark &algorithm) {
+            TuneMeasurement m;
+            m.memory = algorithm.memoryCost();
+            if (m.memory > budget.memoryBytes) {
+                return m;
+            }
+            unsigned int threads = algorithm.reentrant() ? budget.concurrency : 1;
+            std::vector<LatencyHistogram> recorders(threads);
+            // Every _hash run, warmups included, since all of them are in the process CPU time
+            std::vector<size_t> hashed(threads, 0);
+            std::vector<std::thread> workers;
+            Stopwatch watch;
+            watch.start();
+            for (unsigned int i = 0; i < threads; i++) {
+                workers.emplace_back([&, i]() {
+                    for (size_t j = 0; j <= budget.samples; j++) {
+                        const std::string &password = passwords[(i * budget.samples + j) % passwords.size()];
+                        auto start = std::chrono::steady_clock::now();
+                        algorithm._hash(password);
+                        auto end = std::chrono::steady_clock::now();
+                        hashed[i]++;
+                        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                        // A warmup far over the target settles it; no point timing the rest
+                        if (j == 0 && ns > 2 * budget.p99Latency * 1e9) {
+                            recorders[i].record(ns);
+                            break;
+                        }
+                        if (j > 0) {
+                            recorders[i].record(ns);
+                        }
+                    }
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            Sample time = watch.stop();
+            LatencyHistogram all;
+            size_t hashes = 0;
+            for (unsigned int i = 0; i < threads; i++) {
+                all.merge(recorders[i]);
+                hashes += hashed[i];
+            }
+            m.p50 = all.percentile(0.5) * 1e-9;
+            m.p99 = all.percentile(0.99) * 1e-9;
+            m.cpuPerHash = time.processCpu / hashes;
+            // A configuration whose records do not read back is never a fit, however fast
+            const std::string &password = passwords.front();
+            m.fits = m.p99 <= budget.p99Latency && algorithm._checkHash(algorithm._hash(password), password);
+            return m;
+        }
+
+        TuneResult tune(const TuneSpace &space) {
+            TuneResult result;
+            result.algorithm = space.algorithm;
+            std::map<std::pair<uint64_t, uint64_t>, TuneMeasurement> seen;
+            auto evaluate = [&](uint64_t memory, uint64_t time) {
+                auto key = std::make_pair(memory, time);
+                auto it = seen.find(key);
+                if (it != seen.end()) {
+                    return it->second;
+                }
+                std::unique_ptr<HashBenchmark> algorithm(space.make(memory, time));
+                TuneMeasurement m = measure(*algorithm);
+                seen[key] = m;
+                trials.push_back({space.algorithm, memory, time, m});
+                result.evaluations++;
+                return m;
+            };
+
+            uint64_t timeLo = space.time.value(space.time.lo);
+            TuneMeasurement floor = evaluate(space.memory.value(space.memory.lo), timeLo);
+            if (!floor.fits) {
+                return result;
+            }
+            // Latency at the floor predicts where the time knob lands; memory starts from its ceiling
+            uint64_t memoryAt = largestFitting(space.memory.lo, space.memory.hi, space.memory.hi, space.memory.relTol,
+                [&](uint64_t x) { return evaluate(space.memory.value(x), timeLo).fits; });
+            uint64_t memory = space.memory.value(memoryAt);
+            double base = evaluate(memory, timeLo).p99;
+            uint64_t guess = space.time.exponent ? space.time.lo : (uint64_t) (timeLo * budget.p99Latency / base);
+            uint64_t timeAt = largestFitting(space.time.lo, space.time.hi, guess, space.time.relTol,
+                [&](uint64_t x) { return evaluate(memory, space.time.value(x)).fits; });
+
+            result.found = true;
+            result.memory = memory;
+            result.time = space.time.value(timeAt);
+            result.cost = evaluate(result.memory, result.time);
+            result.strength = (double) std::max(result.cost.memory, (size_t) 1) * result.time;
+            return result;
+        }
+
+        static const char *trialCsvHeader() {
+            return "Algorithm,Memory,Time,MemoryBytes,P50(s),P99(s),CpuPerHash(s),Fits";
+        }
+
+        void writeTrials(std::ostream &f) const {
+            for (const Trial &t : trials) {
+                f << t.algorithm << "," << t.memory << "," << t.time << "," << t.cost.memory << ","
+                  << t.cost.p50 << "," << t.cost.p99 << "," << t.cost.cpuPerHash << "," << t.cost.fits << std::endl;
+            }
+        }
+};
+
+#endif // TUNER_HPP
@@ -1,19 +1,137 @@
-#include <crypt.h>
 #include <string.h>
-#include <errno.h>
 #include "framework.hpp"
 #include "base64.h"
+#include "cryptrn.hpp"
+#include "yescrypt_core.hpp"
 
 class Yescrypt: public HashBenchmark {
     private:
         int npow = 0;
         static const int hashLen = 64;
         static const int saltLen = 18;
+        // Salt as crypt-base64 without padding
+        static const int b64SaltLen = saltLen / 3 * 4;
+        // $y$j9T$salt$ and the setting followed by 43 chars of hash
+        static const int settingLen = 7 + b64SaltLen + 1;
+        static const int recordLen = settingLen + 43;
+        // Derived key behind those 43 chars
+        static const int keyLen = 32;
+        static const int r = 32;
+        // Native hashes against a ROM add its size to the setting: a parameter mask of 8 ('5') and
+        // log2 of its blocks, as yescrypt encodes NROM
+        static const int romChars = 2;
+        static const int maxRecordLen = recordLen + romChars;
+
+        // Set for the in-tree yescrypt, which can also read a ROM; otherwise libxcrypt hashes
+        bool native = false;
+        std::shared_ptr<const yescrypt_core::Rom> rom;
+        int romLog = 0;
+        PagePolicy policy = PAGE_DEFAULT;
+
+        inline static thread_local PagePolicy callPolicy = PAGE_DEFAULT;
+
+        static int pagesAllocate(uint8_t **memory, size_t bytes) {
+            void *mem = mapPages(bytes, callPolicy);
+            if (mem == MAP_FAILED) {
+                return yescrypt_core::MEMORY_ALLOCATION_ERROR;
+            }
+            *memory = (uint8_t *) mem;
+            return yescrypt_core::OK;
+        }
+
+        static void pagesFree(uint8_t *memory, size_t bytes) {
+            unmapPages(memory, bytes, callPolicy);
+        }
 
         std::string _hashInternal(const std::string &password, const char *configStr) {
-            char *data = crypt(password.c_str(), configStr);
-            assert(errno == 0);
-            return std::string(data);
+            if (native) {
+                char res[maxRecordLen + 1];
+                return nativeCrypt(password, configStr, res) ? std::string(res) : std::string();
+            }
+            return cryptReentrant(password, configStr);
+        }
+
+        // log2 N and r of a $y$j<N><r> setting; false unless each is one crypt-base64 char below index
+        // 48, since libxcrypt spells larger values with several chars. The prefix is checked first so
+        // a short string is never read past its NUL
+        static bool parseCost(const char *setting, uint64_t &nlog, uint64_t &rvalue) {
+            if (strncmp(setting, "$y$j", 4) != 0) {
+                return false;
+            }
+            const void *n = memchr(base64_table, setting[4], 48);
+            const void *rr = n != NULL ? memchr(base64_table, setting[5], 48) : NULL;
+            if (rr == NULL) {
+                return false;
+            }
+            nlog = (const unsigned char *) n - base64_table + 1;
+            rvalue = (const unsigned char *) rr - base64_table + 1;
+            return true;
+        }
+
+        // Whether parameters read back from a hash stay within costPolicy, raised to this instance's
+        // own configuration; hashing never consults it
+        bool withinPolicy(uint64_t nlog, uint64_t rvalue) {
+            return ((uint64_t) 128 * rvalue << nlog) <= costPolicy.covering(memoryCost(), 1, 0, 0).maxMemory;
+        }
+
+        // crypt() for the settings this class writes, $y$j<N><r>[5<NROM>]$salt[$...], into a
+        // NUL-terminated record of at most maxRecordLen chars; false on anything else, or on a ROM
+        // size other than this instance's ROM
+        bool nativeCrypt(std::string_view password, const char *setting, char *out) {
+            uint64_t nlog, rvalue;
+            const void *nrom = NULL;
+            if (!parseCost(setting, nlog, rvalue)) {
+                return false;
+            }
+            const char *pos = setting + 6;
+            if (*pos == base64_table[7] && (nrom = memchr(base64_table, pos[1], 48)) != NULL) {
+                pos += 2;
+            }
+            const char *end = *pos == '$' ? strchr(pos + 1, '$') : NULL;
+            uint8_t salt[PhcRecord::maxSalt];
+            size_t saltSize;
+            if (end == NULL || end - pos - 1 > b64SaltLen
+                    || !cryptDecode64(std::string_view(pos + 1, end - pos - 1), salt, sizeof(salt), saltSize)) {
+                return false;
+            }
+            const yescrypt_core::Rom *romUsed = NULL;
+            if (nrom != NULL) {
+                size_t romLog = (const unsigned char *) nrom - base64_table + 1;
+                if (rom == nullptr || rom->blocks() != (uint64_t) 1 << romLog) {
+                    return false;
+                }
+                romUsed = rom.get();
+            }
+            uint8_t key[keyLen];
+            callPolicy = policy;
+            bool custom = policy != PAGE_DEFAULT;
+            if (yescrypt_core::kdf(romUsed, (const uint8_t *) password.data(), password.size(), salt, saltSize,
+                    (uint64_t) 1 << nlog, rvalue, 1, 1, custom ? pagesAllocate : NULL, custom ? pagesFree : NULL,
+                    key, keyLen) != yescrypt_core::OK) {
+                return false;
+            }
+            size_t prefix = end - setting + 1;
+            memcpy(out, setting, prefix);
+            cryptEncode64(key, keyLen, out + prefix);
+            return true;
+        }
+
+        int settingLength() const {
+            return settingLen + (rom != nullptr ? romChars : 0);
+        }
+
+        // Write the setting for a fresh salt, NUL-terminated
+        // N = 4096, r = 32, p = 1 as used by passwd
+        void writeSetting(char *configStr) {
+            uint8_t salt[saltLen];
+            generateSeed(saltLen, (char *) salt);
+            char b64salt[b64SaltLen + 1];
+            cryptEncodeSalt(salt, saltLen, b64salt);
+            char romParams[romChars + 1] = "";
+            if (rom != nullptr) {
+                sprintf(romParams, "%c%c", base64_table[7], base64_table[romLog - 1]);
+            }
+            sprintf(configStr, "$y$j%c%c%s$%s$", base64_table[npow-1], base64_table[r-1], romParams, b64salt);
         }
     public:
         Yescrypt(std::string name, int n) : HashBenchmark(name) {
@@ -23,27 +141,122 @@ class Yescrypt: public HashBenchmark {
             }
         }
 
-        std::string _hash(const std::string &password) {
-            uint8_t salt[saltLen];
-            generateSeed(saltLen, (char *) salt);
-            size_t b64saltLen;
-            unsigned char *b64salt = base64_encode(salt, saltLen, &b64saltLen);
-            for (int i = b64saltLen; i >= 0; i--) { // Remove padding
-                if (b64salt[i] == '=' || b64salt[i] == '\n' || b64salt[i] == '\0') {
-                    b64salt[i] = 0;
-                } else {
-                    break;
-                }
+        // Hashes in-tree, reading rom if it is set; the ROM must have r = 32 and is shared, never
+        // written, so any number of instances and threads can use one
+        Yescrypt(std::string name, int n, std::shared_ptr<const yescrypt_core::Rom> rom) : Yescrypt(name, n) {
+            native = true;
+            this->rom = rom;
+            assert(rom == nullptr || rom->blockR() == (uint32_t) r);
+            while (rom != nullptr && ((uint64_t) 1 << romLog) < rom->blocks()) {
+                romLog++;
             }
-            // $y$j9T$salt$
-            // N = 4096, r = 32, p = 1 as used by passwd
-            char configStr[9 + b64saltLen];
-            sprintf(configStr, "$y$j%cT$%s$", base64_table[npow-1], b64salt);
-            free(b64salt);
+        }
+
+        // Only the in-tree yescrypt maps its own memory; libxcrypt keeps to the host's knobs
+        bool setPagePolicy(PagePolicy policy) {
+            this->policy = policy;
+            return native;
+        }
+
+        std::string _hash(const std::string &password) {
+            char configStr[settingLen + romChars + 1];
+            writeSetting(configStr);
             return _hashInternal(password, configStr);
         }
 
+        // Reads any $y$j hash up to costPolicy, through libxcrypt or natively; a setting either
+        // rejects is a mismatch rather than an abort
         bool _checkHash(const std::string &hash, const std::string &password) {
-           return hash == _hashInternal(password, hash.c_str());
+            uint64_t nlog, rvalue;
+            if (!parseCost(hash.c_str(), nlog, rvalue) || !withinPolicy(nlog, rvalue)) {
+                return false;
+            }
+            if (native) {
+                char res[maxRecordLen + 1];
+                return nativeCrypt(password, hash.c_str(), res) && hash == res;
+            }
+            const char *res = cryptView(password, hash.c_str());
+            return res != NULL && hash == res;
+        }
+
+        // $yescrypt$ln=<log2 N>,r=32$salt$hash with raw salt and key; yescrypt decodes the
+        // salt of a $y$ setting before use, so the raw bytes are what it hashes with
+        // With a ROM, its size follows as nrom=<log2 of its blocks>
+        size_t phcHash(std::string_view password, char *out) {
+            char configStr[settingLen + romChars + 1];
+            writeSetting(configStr);
+            char record[maxRecordLen + 1];
+            const char *res = native ? (nativeCrypt(password, configStr, record) ? record : NULL) : cryptView(password, configStr);
+            assert(res != NULL);
+            PhcRecord rec;
+            strcpy(rec.id, "yescrypt");
+            rec.addParam("ln", npow);
+            rec.addParam("r", r);
+            if (rom != nullptr) {
+                rec.addParam("nrom", romLog);
+            }
+            int salt = settingLength() - b64SaltLen - 1;
+            assert(cryptDecode64(std::string_view(configStr + salt, b64SaltLen), rec.salt, PhcRecord::maxSalt, rec.saltLen));
+            assert(cryptDecode64(res + settingLength(), rec.hash, PhcRecord::maxHash, rec.hashLen) && rec.hashLen == keyLen);
+            return phc::encode(rec, out, PHC_MAX_LENGTH);
+        }
+
+        // Rebuilds the $y$ setting with passwd's flags and p = 1; N and r must fit one setting char each
+        // An nrom parameter needs this instance's ROM
+        bool phcDerive(const PhcRecord &rec, std::string_view password, uint8_t *out) {
+            uint64_t ln, rr, pp = 1, nrom = 0;
+            bool hasRom = rec.param("nrom", nrom);
+            if (strcmp(rec.id, "yescrypt") != 0 || !rec.param("ln", ln) || !rec.param("r", rr)
+                    || ln < 1 || ln > 48 || rr < 1 || rr > 48 || (rec.param("p", pp) && pp != 1)
+                    || rec.saltLen == 0 || rec.hashLen != keyLen || (hasRom && (!native || nrom < 1 || nrom > 48))
+                    || !withinPolicy(ln, rr)) {
+                return false;
+            }
+            if (native) {
+                const yescrypt_core::Rom *romUsed = hasRom ? rom.get() : NULL;
+                if (hasRom && (romUsed == NULL || romUsed->blocks() != (uint64_t) 1 << nrom)) {
+                    return false;
+                }
+                callPolicy = policy;
+                bool custom = policy != PAGE_DEFAULT;
+                return yescrypt_core::kdf(romUsed, (const uint8_t *) password.data(), password.size(), rec.salt, rec.saltLen,
+                    (uint64_t) 1 << ln, rr, 1, 1, custom ? pagesAllocate : NULL, custom ? pagesFree : NULL, out, keyLen) == yescrypt_core::OK;
+            }
+            char setting[7 + PhcRecord::maxSalt / 3 * 4 + 4 + 2];
+            char *pos = setting;
+            pos = stpcpy(pos, "$y$j");
+            *pos++ = base64_table[ln - 1];
+            *pos++ = base64_table[rr - 1];
+            *pos++ = '$';
+            pos = cryptEncode64(rec.salt, rec.saltLen, pos);
+            *pos++ = '$';
+            *pos = 0;
+            const char *res = cryptView(password, setting);
+            size_t keySize;
+            return res != NULL && cryptDecode64(strrchr(res, '$') + 1, out, keyLen, keySize) && keySize == keyLen;
+        }
+
+        // N blocks of 128 * r bytes with the passwd default r = 32; a ROM is shared, not per hash
+        size_t memoryCost() {
+            return (size_t) 128 * r << npow;
+        }
+
+        size_t recordSize() {
+            return settingLength() + 43;
+        }
+
+        void hashBatch(const std::string_view *passwords, size_t count, char *out) {
+            char configStr[settingLen + romChars + 1];
+            char record[maxRecordLen + 1];
+            size_t size = recordSize();
+            for (size_t i = 0; i < count; i++) {
+                writeSetting(configStr);
+                if (native) {
+                    assert(nativeCrypt(passwords[i], configStr, record));
+                    memcpy(out + i * size, record, size);
+                } else {
+                    cryptRecord(passwords[i], configStr, out + i * size, size);
+                }
+            }
         }
 };
\ No newline at end of file
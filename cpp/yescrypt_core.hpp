@@ -0,0 +1,518 @@
+#ifndef YESCRYPT_CORE_HPP
+#define YESCRYPT_CORE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <emmintrin.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#include "pagepolicy.hpp"
+#include "scrypt_core.hpp"
+
+// In-tree yescrypt for the flavor libxcrypt's $y$j settings select (RW, 6 pwxform rounds, 4 gathers,
+// 2 simple lanes, 12 KiB S-boxes), so results without a ROM match crypt() bit for bit
+// libxcrypt keeps yescrypt's ROM support internal; here a hash can also read a shared ROM, built
+// once per process as yescrypt_init_shared builds it, or loaded from a file
+// Blocks are kept in the Salsa20 SIMD order scrypt_core uses, which is also the order yescrypt
+// defines pwxform and Integerify on
+namespace yescrypt_core {
+
+static const uint32_t FLAG_RW = 0x002;
+static const uint32_t FLAGS_J = 0x0b6;  // RW | ROUNDS_6 | GATHER_4 | SIMPLE_2 | SBOX_12K
+static const uint32_t FLAG_INIT_SHARED = 0x01000000;
+static const uint32_t FLAG_PREHASH = 0x10000000;
+
+enum Status { OK = 0, INVALID_PARAMETERS = -1, MEMORY_ALLOCATION_ERROR = -2 };
+
+// Same shape as scrypt_core's; allocate returns OK or an error
+typedef int (*AllocateCallback)(uint8_t **memory, size_t bytes);
+typedef void (*FreeCallback)(uint8_t *memory, size_t bytes);
+
+static const int pwxRounds = 6;
+static const int pwxGather = 4;
+static const int sWidth = 8;
+static const size_t sBoxBytes = (size_t) 1 << sWidth << 4;   // 2^Swidth pairs of 64-bit words
+static const size_t sBytes = 3 * sBoxBytes;                   // S2, S1, S0
+static const uint32_t sMask = (((uint32_t) 1 << sWidth) - 1) << 4;
+
+// "yescrypt" and "-ROMhash", the tag in the last 48 bytes of an initialized ROM
+static const uint64_t romTag1 = 0x7470797263736579ULL;
+static const uint64_t romTag2 = 0x687361684d4f522dULL;
+
+typedef scrypt_core::v4u32 Row;
+
+// pwxform state of one instance: three S-boxes that rotate roles after every block, and the
+// position the next S2 write goes to
+struct Sbox {
+    uint8_t *s0;
+    uint8_t *s1;
+    uint8_t *s2;
+    size_t w;
+};
+
+// One 64-byte sub-block, a gather lane per row and two 64-bit simple lanes per row
+static inline void pwxform(Row *x, Sbox &ctx) {
+    uint8_t *s0 = ctx.s0, *s1 = ctx.s1, *s2 = ctx.s2;
+    size_t w = ctx.w;
+    for (int i = 0; i < pwxRounds; i++) {
+        for (int j = 0; j < pwxGather; j++) {
+            __m128i v = (__m128i) x[j];
+            __m128i a = _mm_loadu_si128((const __m128i *) (s0 + (x[j][0] & sMask)));
+            __m128i b = _mm_loadu_si128((const __m128i *) (s1 + (x[j][1] & sMask)));
+            v = _mm_xor_si128(_mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(v, 32), v), a), b);
+            x[j] = (Row) v;
+            // Rounds between the first and the last feed S2
+            if (i != 0 && i != pwxRounds - 1) {
+                _mm_storeu_si128((__m128i *) (s2 + 8 * w), v);
+                w += 2;
+            }
+        }
+    }
+    ctx.s0 = s2;
+    ctx.s1 = s0;
+    ctx.s2 = s1;
+    ctx.w = w & ((sBoxBytes >> 3) - 1);
+}
+
+// BlockMix_pwxform in place over 2r sub-blocks, then Salsa20/2 on the last
+static void blockMixPwxform(Row *b, Sbox &ctx, uint32_t r) {
+    size_t last = 8 * (size_t) r - 4;
+    Row x[4] = {b[last], b[last + 1], b[last + 2], b[last + 3]};
+    for (size_t i = 0; i < 8 * (size_t) r; i += 4) {
+        for (int k = 0; k < 4; k++) {
+            x[k] ^= b[i + k];
+        }
+        pwxform(x, ctx);
+        memcpy(b + i, x, sizeof(x));
+    }
+    scrypt_core::salsa<2>(x[0], x[1], x[2], x[3]);
+    memcpy(b + last, x, sizeof(x));
+}
+
+// Word 0 of the last sub-block with word 1, in row 3 lane 1, above it
+static inline uint64_t integerify(const Row *x, uint32_t r) {
+    size_t last = 8 * (size_t) r - 4;
+    return x[last][0] | (uint64_t) x[last + 3][1] << 32;
+}
+
+static inline uint64_t p2floor(uint64_t x) {
+    uint64_t y;
+    while ((y = x & (x - 1)) != 0) {
+        x = y;
+    }
+    return x;
+}
+
+// x into [0, i), the block indices written so far
+static inline uint64_t wrap(uint64_t x, uint64_t i) {
+    uint64_t n = p2floor(i);
+    return (x & (n - 1)) + (i - n);
+}
+
+static inline void xorRows(Row *x, const Row *y, size_t rows) {
+    for (size_t k = 0; k < rows; k++) {
+        x[k] ^= y[k];
+    }
+}
+
+// subs 64-byte sub-blocks of bytes into rows, row k lane c holding word (4k + 5c) mod 16, and back
+static void toRows(const uint8_t *b, Row *x, size_t subs) {
+    for (size_t s = 0; s < subs; s++) {
+        for (int k = 0; k < 4; k++) {
+            for (int c = 0; c < 4; c++) {
+                uint32_t w;
+                memcpy(&w, b + 64 * s + 4 * ((4 * k + 5 * c) & 15), 4);
+                x[4 * s + k][c] = w;
+            }
+        }
+    }
+}
+
+static void fromRows(const Row *x, uint8_t *b, size_t subs) {
+    for (size_t s = 0; s < subs; s++) {
+        for (int k = 0; k < 4; k++) {
+            for (int c = 0; c < 4; c++) {
+                uint32_t w = x[4 * s + k][c];
+                memcpy(b + 64 * s + 4 * ((4 * k + 5 * c) & 15), &w, 4);
+            }
+        }
+    }
+}
+
+// A ROM as a hash sees it: blocks of 128 * r bytes, read only
+struct RomView {
+    const Row *blocks = NULL;
+    uint64_t count = 0;
+};
+
+// First loop of SMix over N blocks of V; without ctx BlockMix is scrypt's Salsa20/8 one and y is
+// its scratch, as for the S-boxes
+static void smix1(Row *x, Row *y, uint32_t r, uint64_t N, bool rw, Row *v, RomView rom, Sbox *ctx) {
+    size_t s = 8 * (size_t) r;
+    for (uint64_t i = 0; i < N; i++) {
+        memcpy(v + s * i, x, s * sizeof(Row));
+        if (rom.blocks != NULL && i == 0) {
+            xorRows(x, rom.blocks + s * (rom.count - 1), s);
+        } else if (rom.blocks != NULL && (i & 1)) {
+            xorRows(x, rom.blocks + s * (integerify(x, r) & (rom.count - 1)), s);
+        } else if (rw && i > 1) {
+            xorRows(x, v + s * wrap(integerify(x, r), i), s);
+        }
+        if (ctx != NULL) {
+            blockMixPwxform(x, *ctx, r);
+        } else {
+            scrypt_core::blockMix<Row, false>(x, NULL, y, r);
+            memcpy(x, y, s * sizeof(Row));
+        }
+    }
+}
+
+// Second loop of SMix, Nloop steps; with rw each V block read is replaced by the new one
+static void smix2(Row *x, uint32_t r, uint64_t N, uint64_t nloop, bool rw, Row *v, RomView rom, Sbox &ctx) {
+    size_t s = 8 * (size_t) r;
+    for (uint64_t i = 0; i < nloop; i++) {
+        if (rom.blocks != NULL && (i & 1)) {
+            xorRows(x, rom.blocks + s * (integerify(x, r) & (rom.count - 1)), s);
+        } else {
+            Row *vj = v + s * (integerify(x, r) & (N - 1));
+            xorRows(x, vj, s);
+            if (rw) {
+                memcpy(vj, x, s * sizeof(Row));
+            }
+        }
+        blockMixPwxform(x, ctx, r);
+    }
+}
+
+// Indices [first, last) of count items for worker w of workers
+template <typename Work>
+static void onWorkers(uint32_t workers, uint64_t count, Work work) {
+    auto run = [&](uint32_t w) {
+        work(count * w / workers, count * (w + 1) / workers);
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t w = 1; w < workers; w++) {
+        threads.emplace_back(run, w);
+    }
+    run(0);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+// SMix over the p blocks of B; each instance gets its own chunk of V and its own S-boxes for the
+// first part, then all of them read all of V; instances are split over workers threads
+static void smix(uint8_t *B, uint32_t r, uint64_t N, uint32_t p, uint32_t t, uint32_t flags, Row *v, RomView rom,
+        uint8_t *S, uint8_t *passwd, uint32_t workers) {
+    size_t s = 8 * (size_t) r;
+    size_t blockBytes = 128 * (size_t) r;
+    uint64_t nchunk = N / p;
+    uint64_t nloopAll = nchunk;
+    if (t <= 1) {
+        if (t) {
+            nloopAll *= 2;
+        }
+        nloopAll = (nloopAll + 2) / 3;
+    } else {
+        nloopAll *= t - 1;
+    }
+    uint64_t nloopRw = (flags & FLAG_INIT_SHARED) ? nloopAll : nloopAll / p;
+    nchunk &= ~(uint64_t) 1;
+    nloopAll = (nloopAll + 1) & ~(uint64_t) 1;
+    nloopRw = (nloopRw + 1) & ~(uint64_t) 1;
+
+    std::vector<Sbox> ctx(p);
+    onWorkers(workers, p, [&](uint64_t first, uint64_t last) {
+        std::vector<Row> x(2 * s);
+        for (uint64_t i = first; i < last; i++) {
+            uint8_t *bi = B + blockBytes * i;
+            uint64_t np = i < p - 1 ? nchunk : N - nchunk * i;
+            // S-boxes from the first 128 bytes of B_i, by scrypt's own SMix1
+            uint8_t *si = S + sBytes * i;
+            toRows(bi, x.data(), 2);
+            smix1(x.data(), x.data() + 8, 1, sBytes / 128, false, (Row *) si, RomView(), NULL);
+            fromRows(x.data(), bi, 2);
+            ctx[i] = {si + 2 * sBoxBytes, si + sBoxBytes, si, 0};
+            if (i == 0) {
+                uint8_t mac[32];
+                HMAC(EVP_sha256(), bi + blockBytes - 64, 64, passwd, 32, mac, NULL);
+                memcpy(passwd, mac, sizeof(mac));
+            }
+            toRows(bi, x.data(), 2 * r);
+            smix1(x.data(), NULL, r, np, true, v + s * nchunk * i, rom, &ctx[i]);
+            smix2(x.data(), r, p2floor(np), nloopRw, true, v + s * nchunk * i, rom, ctx[i]);
+            fromRows(x.data(), bi, 2 * r);
+        }
+        OPENSSL_cleanse(x.data(), x.size() * sizeof(Row));
+    });
+    if (nloopAll == nloopRw) {
+        return;
+    }
+    onWorkers(workers, p, [&](uint64_t first, uint64_t last) {
+        std::vector<Row> x(s);
+        for (uint64_t i = first; i < last; i++) {
+            toRows(B + blockBytes * i, x.data(), 2 * r);
+            smix2(x.data(), r, N, nloopAll - nloopRw, false, v, rom, ctx[i]);
+            fromRows(x.data(), B + blockBytes * i, 2 * r);
+        }
+        OPENSSL_cleanse(x.data(), x.size() * sizeof(Row));
+    });
+}
+
+// yescrypt_kdf_body for the j flavor; with FLAG_INIT_SHARED V is initV, the ROM half being built
+static int kdfBody(RomView rom, Row *initV, const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+        uint32_t flags, uint64_t N, uint32_t r, uint32_t p, uint32_t t, uint32_t threads,
+        AllocateCallback allocate, FreeCallback deallocate, uint8_t *out, size_t outLen) {
+    if (N < 2 || (N & (N - 1)) != 0 || r == 0 || p == 0 || (uint64_t) r * p >= ((uint64_t) 1 << 30) || N / p <= 1
+            || N > SIZE_MAX / 128 / r || N > UINT64_MAX / ((uint64_t) t + 1) || passwordLen > INT32_MAX || saltLen > INT32_MAX
+            || outLen > INT32_MAX || outLen == 0) {
+        return INVALID_PARAMETERS;
+    }
+    size_t vBytes = 128 * (size_t) r * N;
+    size_t bBytes = 128 * (size_t) r * p;
+    uint8_t *v = (uint8_t *) initV;
+    if (initV == NULL) {
+        if (allocate != NULL) {
+            if (allocate(&v, vBytes) != OK) {
+                v = NULL;
+            }
+        } else if (posix_memalign((void **) &v, 64, vBytes) != 0) {
+            v = NULL;
+        }
+        if (v == NULL) {
+            return MEMORY_ALLOCATION_ERROR;
+        }
+    }
+    uint8_t *B = (uint8_t *) malloc(bBytes);
+    uint8_t *S = NULL;
+    if (B == NULL || posix_memalign((void **) &S, 64, sBytes * p) != 0) {
+        free(B);
+        if (initV == NULL) {
+            deallocate != NULL ? deallocate(v, vBytes) : free(v);
+        }
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    // The password is replaced by an HMAC of it, then by the start of B, then by an HMAC
+    // over the last sub-block of B_0 once its S-boxes are made
+    uint8_t passwd[32];
+    HMAC(EVP_sha256(), "yescrypt-prehash", (flags & FLAG_PREHASH) ? 16 : 8, password, passwordLen, passwd, NULL);
+    PKCS5_PBKDF2_HMAC((const char *) passwd, sizeof(passwd), salt, saltLen, 1, EVP_sha256(), bBytes, B);
+    memcpy(passwd, B, sizeof(passwd));
+    smix(B, r, N, p, t, flags, (Row *) v, rom, S, passwd, std::max(1u, std::min(threads, p)));
+
+    uint8_t dk[32];
+    const uint8_t *dkp = out;
+    if (outLen < sizeof(dk)) {
+        PKCS5_PBKDF2_HMAC((const char *) passwd, sizeof(passwd), B, bBytes, 1, EVP_sha256(), sizeof(dk), dk);
+        dkp = dk;
+    }
+    PKCS5_PBKDF2_HMAC((const char *) passwd, sizeof(passwd), B, bBytes, 1, EVP_sha256(), outLen, out);
+    // StoredKey as SCRAM (RFC 5802) makes it, so the steps so far could run on a client
+    if (!(flags & FLAG_PREHASH)) {
+        uint8_t clientKey[32];
+        HMAC(EVP_sha256(), dkp, sizeof(dk), (const uint8_t *) "Client Key", 10, clientKey, NULL);
+        SHA256(clientKey, sizeof(clientKey), dk);
+        memcpy(out, dk, std::min(outLen, sizeof(dk)));
+        OPENSSL_cleanse(clientKey, sizeof(clientKey));
+    }
+
+    OPENSSL_cleanse(passwd, sizeof(passwd));
+    OPENSSL_cleanse(dk, sizeof(dk));
+    OPENSSL_cleanse(B, bBytes);
+    OPENSSL_cleanse(S, sBytes * p);
+    free(B);
+    free(S);
+    if (initV == NULL) {
+        deallocate != NULL ? deallocate(v, vBytes) : free(v);
+    }
+    return OK;
+}
+
+// A ROM yescrypt_init_shared would build: blocks of 128 * r bytes that every hash reads and none
+// writes, so one copy serves every thread; the memory is read-only once it is filled
+class Rom {
+    private:
+        uint8_t *memory = NULL;
+        size_t size = 0;
+        uint64_t count = 0;
+        uint32_t r = 0;
+        PagePolicy policy = PAGE_DEFAULT;
+        bool fileMapped = false;
+
+        Rom(uint64_t count, uint32_t r, PagePolicy policy) : size(128 * (size_t) r * count), count(count), r(r), policy(policy) {}
+
+        static bool validSize(uint64_t count, uint32_t r) {
+            return count >= 2 && (count & (count - 1)) == 0 && r > 0 && count <= SIZE_MAX / 128 / r;
+        }
+
+        bool map() {
+            void *mem = mapPages(size, policy);
+            memory = mem == MAP_FAILED ? NULL : (uint8_t *) mem;
+            return memory != NULL;
+        }
+
+        void seal() {
+            mprotect(memory, pageMappedSize(size, policy), PROT_READ);
+        }
+
+    public:
+        Rom(const Rom &) = delete;
+        Rom &operator=(const Rom &) = delete;
+
+        ~Rom() {
+            if (memory != NULL) {
+                if (fileMapped) {
+                    munmap(memory, size);
+                } else {
+                    unmapPages(memory, size, policy);
+                }
+            }
+        }
+
+        // Fill count blocks from seed in two halves, the second reading the first as its ROM, on
+        // min(threads, p) threads; p is part of what the ROM holds. NULL if it cannot be built
+        static std::shared_ptr<Rom> build(std::string_view seed, uint64_t count, uint32_t r, uint32_t p, uint32_t threads, PagePolicy policy) {
+            if (!validSize(count, r) || count / 2 / p <= 1) {
+                return nullptr;
+            }
+            std::shared_ptr<Rom> rom(new Rom(count, r, policy));
+            if (!rom->map()) {
+                return nullptr;
+            }
+            uint64_t half = count / 2;
+            Row *first = (Row *) rom->memory;
+            Row *second = first + 8 * (size_t) r * half;
+            uint8_t salt[32];
+            uint32_t flags = FLAGS_J | FLAG_INIT_SHARED;
+            if (kdfBody(RomView(), first, (const uint8_t *) seed.data(), seed.size(), (const uint8_t *) "yescrypt-ROMhash", 16,
+                        flags, half, r, p, 0, threads, NULL, NULL, salt, sizeof(salt)) != OK
+                    || kdfBody({first, half}, second, (const uint8_t *) seed.data(), seed.size(), salt, sizeof(salt),
+                        flags, half, r, p, 0, threads, NULL, NULL, salt, sizeof(salt)) != OK) {
+                return nullptr;
+            }
+            uint8_t *tag = rom->memory + rom->size - 48;
+            memcpy(tag, &romTag1, 8);
+            memcpy(tag + 8, &romTag2, 8);
+            memcpy(tag + 16, salt, sizeof(salt));
+            rom->seal();
+            return rom;
+        }
+
+        // A ROM saved earlier, count blocks of 128 * r bytes; NULL if the file does not hold one
+        // PAGE_DEFAULT maps the file itself, so processes share its page cache; any other policy
+        // copies it into memory backed as that policy asks
+        static std::shared_ptr<Rom> load(const std::string &path, uint64_t count, uint32_t r, PagePolicy policy) {
+            if (!validSize(count, r)) {
+                return nullptr;
+            }
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return nullptr;
+            }
+            std::shared_ptr<Rom> rom(new Rom(count, r, policy));
+            struct stat st;
+            bool ok = fstat(fd, &st) == 0 && (uint64_t) st.st_size == rom->size;
+            if (ok && policy == PAGE_DEFAULT) {
+                void *mem = mmap(NULL, rom->size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+                ok = mem != MAP_FAILED;
+                if (ok) {
+                    rom->memory = (uint8_t *) mem;
+                    rom->fileMapped = true;
+                }
+            } else if (ok && rom->map()) {
+                for (size_t done = 0; ok && done < rom->size; ) {
+                    ssize_t n = pread(fd, rom->memory + done, rom->size - done, done);
+                    ok = n > 0;
+                    done += ok ? n : 0;
+                }
+                rom->seal();
+            } else {
+                ok = false;
+            }
+            close(fd);
+            return ok && rom->tagged() ? rom : nullptr;
+        }
+
+        bool save(const std::string &path) const {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write((const char *) memory, size);
+            file.close();
+            return !file.fail();
+        }
+
+        // The tag yescrypt checks before hashing with a ROM
+        bool tagged() const {
+            uint64_t tag1, tag2;
+            memcpy(&tag1, memory + size - 48, 8);
+            memcpy(&tag2, memory + size - 40, 8);
+            return tag1 == romTag1 && tag2 == romTag2;
+        }
+
+        uint64_t blocks() const {
+            return count;
+        }
+
+        uint32_t blockR() const {
+            return r;
+        }
+
+        size_t bytes() const {
+            return size;
+        }
+
+        PagePolicy pagePolicy() const {
+            return policy;
+        }
+
+        RomView view() const {
+            return {(const Row *) memory, count};
+        }
+};
+
+// yescrypt_kdf for the j flavor with t = 0, against rom if it is set; the ROM's r must be r
+// Large costs first prehash the password with the same parameters and N / 64, as yescrypt does
+// V comes from allocate and goes back to deallocate on this thread, or from posix_memalign
+inline int kdf(const Rom *rom, const uint8_t *password, size_t passwordLen, const uint8_t *salt, size_t saltLen,
+        uint64_t N, uint32_t r, uint32_t p, uint32_t threads, AllocateCallback allocate, FreeCallback deallocate,
+        uint8_t *out, size_t outLen) {
+    RomView view;
+    if (rom != NULL) {
+        if (rom->blockR() != r || !rom->tagged()) {
+            return INVALID_PARAMETERS;
+        }
+        view = rom->view();
+    }
+    uint8_t dk[32];
+    if (p >= 1 && N / p >= 0x100 && N / p * r >= 0x20000) {
+        int status = kdfBody(view, NULL, password, passwordLen, salt, saltLen, FLAGS_J | FLAG_PREHASH, N >> 6, r, p, 0,
+            threads, allocate, deallocate, dk, sizeof(dk));
+        if (status != OK) {
+            return status;
+        }
+        password = dk;
+        passwordLen = sizeof(dk);
+    }
+    int status = kdfBody(view, NULL, password, passwordLen, salt, saltLen, FLAGS_J, N, r, p, 0,
+        threads, allocate, deallocate, out, outLen);
+    OPENSSL_cleanse(dk, sizeof(dk));
+    return status;
+}
+
+}  // namespace yescrypt_core
+
+#endif // YESCRYPT_CORE_HPP
@@ -16,11 +16,18 @@ def diff_idx(s1, s2):
 def hex_to_bitstring(s):
     return bin(int(s, 16))[2:].zfill(256)
 
+# Hash one bitstring through a long-lived `hash_one --batch` process
+def hash_one(proc, alg, bitstring):
+    proc.stdin.write(f"{alg} {bitstring}\n")
+    proc.stdin.flush()
+    return proc.stdout.readline().strip()
+
 if __name__ == "__main__":
     random.seed(1337)
     random_bitstring = ''.join(random.choices('01', k=256))
     print("Diffusion index")
     print("Alg,Score")
+    proc = subprocess.Popen(["../cpp/hash_one", "--batch"], stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
     for alg in ["argon2", "sha256", "pbkdf2-600k", "pbkdf2-1m", "yescrypt", "scrypt-mem", "scrypt-bal", "scrypt-cpu", "plaintext"]:
         total_distance = 0
         trials = 256
@@ -29,8 +36,10 @@ if __name__ == "__main__":
                 sys.stderr.write(f"\r{alg}: {i}/{trials}\n")
             # Flip ith bit of random_bitstring
             this_bitstring = random_bitstring[:i] + ('1' if random_bitstring[i] == '0' else '0') + random_bitstring[i+1:]
-            hash = subprocess.check_output(["../cpp/hash_one", alg, this_bitstring]).decode().strip()
+            hash = hash_one(proc, alg, this_bitstring)
 
             distance = diff_idx(this_bitstring, hex_to_bitstring(hash))
             total_distance += distance
         print(alg + "," + str(total_distance / trials))
+    proc.stdin.close()
+    proc.wait()